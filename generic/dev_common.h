@@ -24,6 +24,8 @@
 #define dev_read(addr)					ga_reg_read8(addr, 0xff)
 #define dev_read8(addr)				ga_reg_read8(addr, 0xff)
 #define dev_read16(addr)				ga_reg_read16(addr, 0xffff)
+/* Read a status register (read without side effects) without taking the lock */
+#define dev_read_status(addr)				ga_reg_read8_lockless(addr, 0xff)
 #define dev_write(addr, val)				ga_reg_write8(addr, 0xff, val, GA_WRITE)
 #define dev_write8(addr, val)				ga_reg_write8(addr, 0xff, val, GA_WRITE)
 #define dev_write16(addr, val)				ga_reg_write16(addr, 0xffff, val, GA_WRITE)
@@ -31,4 +33,11 @@
 #define dev_read_modify_write(addr, mask, upd)		ga_reg_write8(addr, mask, upd, GA_READ_WRITE_ALWAYS) /* forced write */
 #define dev_read_modify_write_cond(addr, mask, upd)	ga_reg_write8(addr, mask, upd, GA_READ_WRITE_CONDITIONAL) /* conditional write */
 
+/* Same accesses as descriptors for dev_batch(), which executes them under one lock */
+#define DEV_OP_READ(addr)				GA_REG_OP(addr, 8, GA_READ, 0xff, 0)
+#define DEV_OP_WRITE(addr, val)				GA_REG_OP(addr, 8, GA_WRITE, 0xff, val)
+#define DEV_OP_READ_MODIFY_WRITE(addr, mask, upd)	GA_REG_OP(addr, 8, GA_READ_WRITE_ALWAYS, mask, upd)
+#define DEV_OP_READ_MODIFY_WRITE_COND(addr, mask, upd)	GA_REG_OP(addr, 8, GA_READ_WRITE_CONDITIONAL, mask, upd)
+#define dev_batch(ops, count)				ga_reg_batch(ops, count)
+
 #endif /* __DEV_COMMON_H__ */
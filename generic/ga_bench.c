@@ -0,0 +1,434 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *
+*******************************************************************************/
+#define DRIVER_VERSION		"1.4"
+
+/* Contention benchmark for generic_access.
+ *
+ * On load, a number of threads (one per online cpu, bound to that cpu) hammer
+ * ga_reg_write32/ga_reg_read32. The run is repeated for 1, 2, 4, ... threads
+ * and the aggregated number of register accesses per second is logged.
+ * The "registers" are plain kernel pages, so no hardware is needed.
+ *
+ *   # insmod ga_bench.ko                  (every thread uses its own page)
+ *   # insmod ga_bench.ko shared=1         (all threads use the same register)
+ *
+ * The cost of the access hooks (struct ga_ioaddr_ops) is measured with:
+ *   # insmod ga_bench.ko hook_mode=1          (hooks installed elsewhere)
+ *   # insmod ga_bench.ko hook_mode=2          (registers are hooked)
+ * Add ranges=N to install N more hooked ranges (lookup cost), and churn=1 to
+ * keep adding and removing a hooked range while the threads run.
+ *
+ * The shadow cache (GA_CACHE_XXX policy of the registers) is measured with:
+ *   # insmod ga_bench.ko cache=1          (read/update/write from the cache)
+ *   # insmod ga_bench.ko cache=2          (reads from the cache as well)
+ *
+ * Posted writes (ga_posted_init) of the hooked registers are measured with:
+ *   # insmod ga_bench.ko hook_mode=2 posted=32
+ */
+
+#include <linux/module.h>   /* Needed by all modules */
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include "generic_access.h"
+
+/******************************************************************************
+ * Module parameters
+ ******************************************************************************/
+static int threads = 0;
+module_param(threads, int, 0444);
+MODULE_PARM_DESC(threads, "Maximum number of threads (0 = number of online cpus)");
+
+static int iterations = 1000000;
+module_param(iterations, int, 0444);
+MODULE_PARM_DESC(iterations, "Number of write/read pairs per thread");
+
+static int shared = 0;
+module_param(shared, int, 0444);
+MODULE_PARM_DESC(shared, "All threads access the same register");
+
+static int access_size = 32;
+module_param(access_size, int, 0444);
+MODULE_PARM_DESC(access_size, "Access size in bits (8, 16, 32 or 64)");
+
+#define GA_BENCH_HOOK_NONE	0 /* No hooks installed */
+#define GA_BENCH_HOOK_OTHER	1 /* Hooks installed on another range */
+#define GA_BENCH_HOOK_SAME	2 /* Hooks installed on the accessed registers */
+
+static int hook_mode = GA_BENCH_HOOK_NONE;
+module_param(hook_mode, int, 0444);
+MODULE_PARM_DESC(hook_mode, "0 = no hooks, 1 = hooks on another range, 2 = hooks on the accessed registers");
+
+#define GA_BENCH_MAX_RANGES	256
+
+static int ranges = 1;
+module_param(ranges, int, 0444);
+MODULE_PARM_DESC(ranges, "Number of hooked ranges which are not accessed (hook modes 1 and 2, max 256)");
+
+static int churn = 0;
+module_param(churn, int, 0444);
+MODULE_PARM_DESC(churn, "Add and remove a hooked range during the measurement");
+
+static int cache = GA_CACHE_NONE;
+module_param(cache, int, 0444);
+MODULE_PARM_DESC(cache, "Shadow cache policy of the registers (0 = none, 1 = write, 2 = read/write), not with hook mode 2");
+
+static int posted = 0;
+module_param(posted, int, 0444);
+MODULE_PARM_DESC(posted, "Depth of the posted write queue of the registers (0 = not posted), hook mode 2 only");
+
+static int lock_mode = GA_LM_SPINLOCK;
+module_param(lock_mode, int, 0444);
+MODULE_PARM_DESC(lock_mode, "Lock mode (0 = spinlock, 1 = mutex), only when no other module uses generic_access");
+
+/******************************************************************************/
+struct ga_bench_thread {
+	struct task_struct	*task;
+	void __iomem		*reg;
+	u64			elapsed_ns;
+};
+
+/* Register pages: one per thread (or one when shared), one for the ranges
+ * which are not accessed and one for the churn range.
+ */
+static u8 *ga_bench_regs;
+static int ga_bench_pages;
+
+static DECLARE_COMPLETION(ga_bench_start);
+static DECLARE_COMPLETION(ga_bench_done);
+static atomic_t ga_bench_running;
+
+/******************************************************************************/
+/* The hooks emulate the registers in memory: 'opaque' is the mapped base */
+#define GA_BENCH_DEFINE_HOOKS(__T,__rf,__wf)						\
+static __T __rf(phys_addr_t addr, void *opaque)						\
+{											\
+	return *(__T *)((u8 *)opaque + addr);						\
+}											\
+											\
+static void __wf(__T val, phys_addr_t addr, void *opaque)				\
+{											\
+	*(__T *)((u8 *)opaque + addr) = val;						\
+}
+
+GA_BENCH_DEFINE_HOOKS(u8,  ga_bench_read8,  ga_bench_write8)
+GA_BENCH_DEFINE_HOOKS(u16, ga_bench_read16, ga_bench_write16)
+GA_BENCH_DEFINE_HOOKS(u32, ga_bench_read32, ga_bench_write32)
+GA_BENCH_DEFINE_HOOKS(u64, ga_bench_read64, ga_bench_write64)
+
+static struct ga_ioaddr_ops ga_bench_ops = {
+	.read8		= ga_bench_read8,
+	.read16		= ga_bench_read16,
+	.read32		= ga_bench_read32,
+	.read64		= ga_bench_read64,
+	.write8		= ga_bench_write8,
+	.write16	= ga_bench_write16,
+	.write32	= ga_bench_write32,
+	.write64	= ga_bench_write64,
+};
+
+/******************************************************************************/
+static inline u8 *ga_bench_page(int page)
+{
+	return ga_bench_regs + page * PAGE_SIZE;
+}
+
+/******************************************************************************/
+static int ga_bench_hooks_add(void)
+{
+	u8	*other = ga_bench_page(ga_bench_pages);
+	int	slice = PAGE_SIZE / ranges;
+	int	i, ret;
+
+	for (i = 0; i < ranges; i++) {
+		ret = ga_add_ioaddr_ops((void __force __iomem *)(other + i * slice), i * slice, slice, &ga_bench_ops, other);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (hook_mode == GA_BENCH_HOOK_SAME) {
+		for (i = 0; i < ga_bench_pages; i++) {
+			ret = ga_add_ioaddr_ops((void __force __iomem *)ga_bench_page(i), 0, PAGE_SIZE, &ga_bench_ops, ga_bench_page(i));
+			if ((ret == 0) && (posted > 0))
+				ret = ga_posted_init((void __force __iomem *)ga_bench_page(i), posted, 0);
+			if (ret < 0)
+				return ret;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************/
+static void ga_bench_hooks_remove(void)
+{
+	u8	*other = ga_bench_page(ga_bench_pages);
+	int	slice = PAGE_SIZE / ranges;
+	int	i;
+
+	for (i = 0; i < ranges; i++)
+		ga_remove_ioaddr_ops((void __force __iomem *)(other + i * slice));
+
+	if (hook_mode == GA_BENCH_HOOK_SAME) {
+		for (i = 0; i < ga_bench_pages; i++)
+			ga_remove_ioaddr_ops((void __force __iomem *)ga_bench_page(i));
+	}
+}
+
+/******************************************************************************/
+/* Add and remove a hooked range until all threads are done */
+static int ga_bench_churn(void)
+{
+	void __iomem	*reg = (void __force __iomem *)ga_bench_page(ga_bench_pages + 1);
+	int		count = 0;
+
+	while (!try_wait_for_completion(&ga_bench_done)) {
+		if (ga_add_ioaddr_ops(reg, 0, PAGE_SIZE, &ga_bench_ops, (void __force *)reg) == 0) {
+			ga_remove_ioaddr_ops(reg);
+			count++;
+		}
+		cond_resched();
+	}
+	return count;
+}
+
+/******************************************************************************/
+static int ga_bench_cache_add(void)
+{
+	int i, ret;
+
+	for (i = 0; i < ga_bench_pages; i++) {
+		ret = ga_cache_init((void __force __iomem *)ga_bench_page(i), PAGE_SIZE);
+		if (ret == 0)
+			ret = ga_cache_set_policy((void __force __iomem *)ga_bench_page(i), PAGE_SIZE, cache);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+static void ga_bench_cache_remove(void)
+{
+	int i;
+
+	for (i = 0; i < ga_bench_pages; i++)
+		ga_cache_exit((void __force __iomem *)ga_bench_page(i));
+}
+
+/******************************************************************************/
+static int ga_bench_thread_fn(void *data)
+{
+	struct ga_bench_thread	*t = data;
+	ktime_t			start;
+	int			i;
+
+	wait_for_completion(&ga_bench_start);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		u64 val;
+		ga_reg_write(t->reg, access_size, 0x0f, i, GA_READ_WRITE_ALWAYS);
+		ga_reg_read(t->reg, access_size, ~0ULL, &val);
+	}
+	t->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&ga_bench_running))
+		complete(&ga_bench_done);
+
+	/* Wait for kthread_stop() */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_bench_run(struct ga_bench_thread *t, const int *cpus, int count)
+{
+	u64	elapsed_ns = 0;
+	u64	accesses;
+	int	churns = 0;
+	int	i, ret = 0;
+
+	reinit_completion(&ga_bench_start);
+	reinit_completion(&ga_bench_done);
+	atomic_set(&ga_bench_running, count);
+
+	for (i = 0; i < count; i++) {
+		t[i].task = kthread_create_on_cpu(ga_bench_thread_fn, &t[i], cpus[i], "ga_bench/%u");
+		if (IS_ERR(t[i].task)) {
+			ret = PTR_ERR(t[i].task);
+			count = i;
+			goto stop;
+		}
+		wake_up_process(t[i].task);
+	}
+
+	complete_all(&ga_bench_start);
+	if (churn)
+		churns = ga_bench_churn();
+	else
+		wait_for_completion(&ga_bench_done);
+
+	for (i = 0; i < count; i++)
+		elapsed_ns = max(elapsed_ns, t[i].elapsed_ns);
+
+	/* Every iteration does one read/modify/write and one read */
+	accesses = (u64)count * iterations * 2;
+	printk(KERN_INFO "ga_bench: %3d threads: %10llu accesses/s (%llu ms, %d range add/remove)\n",
+		count, div64_u64(accesses * NSEC_PER_SEC, max_t(u64, elapsed_ns, 1)),
+		div64_u64(elapsed_ns, NSEC_PER_MSEC), churns);
+
+	return 0;
+
+stop:
+	/* Let the threads which were started run to completion */
+	complete_all(&ga_bench_start);
+	for (i = 0; i < count; i++)
+		kthread_stop(t[i].task);
+	return ret;
+}
+
+/******************************************************************************/
+static void ga_bench_stop(struct ga_bench_thread *t, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		kthread_stop(t[i].task);
+}
+
+/******************************************************************************
+ * Module initializations
+ ******************************************************************************/
+static int __init ga_bench_init(void)
+{
+	struct ga_bench_thread	*t;
+	int			*cpus;
+	int			cpu, count = 0;
+	int			i, ret = 0;
+
+	printk(KERN_INFO "ga_bench: module init version %s\n", DRIVER_VERSION);
+
+	if (access_size != 8 && access_size != 16 && access_size != 32 && access_size != 64)
+		return -EINVAL;
+
+	if (threads <= 0 || threads > num_online_cpus())
+		threads = num_online_cpus();
+
+	t = kcalloc(threads, sizeof(*t), GFP_KERNEL);
+	cpus = kcalloc(threads, sizeof(*cpus), GFP_KERNEL);
+	if (t == NULL || cpus == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for_each_online_cpu(cpu) {
+		if (count == threads)
+			break;
+		cpus[count++] = cpu;
+	}
+	threads = count;
+
+	if (ranges <= 0 || ranges > GA_BENCH_MAX_RANGES)
+		ranges = 1;
+	if (hook_mode == GA_BENCH_HOOK_SAME)
+		cache = GA_CACHE_NONE;
+	else
+		posted = 0;
+
+	/* Allocate the "registers" */
+	ga_bench_pages = shared ? 1 : threads;
+	ga_bench_regs = vzalloc((ga_bench_pages + 2) * PAGE_SIZE);
+	if (ga_bench_regs == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < threads; i++)
+		t[i].reg = (void __force __iomem *)ga_bench_page(shared ? 0 : i);
+
+	if (hook_mode != GA_BENCH_HOOK_NONE) {
+		ret = ga_bench_hooks_add();
+		if (ret < 0)
+			goto out;
+	}
+	if (cache != GA_CACHE_NONE) {
+		ret = ga_bench_cache_add();
+		if (ret < 0)
+			goto out;
+	}
+
+	if (lock_mode != GA_LM_SPINLOCK) {
+		ret = ga_set_lock_mode(lock_mode);
+		if (ret < 0) {
+			printk(KERN_ERR "ga_bench: cannot switch to lock mode %d (%d), generic_access has other users\n",
+				lock_mode, ret);
+			goto out;
+		}
+	}
+
+	printk(KERN_INFO "ga_bench: %s register(s), %d-bit, %s, hook mode %d (%d ranges), cache %d, posted %d, %d iterations\n",
+		shared ? "shared" : "per-thread", access_size, lock_mode == GA_LM_MUTEX ? "mutex" : "spinlock",
+		hook_mode, hook_mode != GA_BENCH_HOOK_NONE ? ranges : 0, cache, posted, iterations);
+
+	for (count = 1; ; count = min(count * 2, threads)) {
+		ret = ga_bench_run(t, cpus, count);
+		if (ret < 0)
+			break;
+		ga_bench_stop(t, count);
+		if (count == threads)
+			break;
+	}
+
+	if (lock_mode != GA_LM_SPINLOCK)
+		ga_set_lock_mode(GA_LM_SPINLOCK);
+
+out:
+	if (ga_bench_regs != NULL && hook_mode != GA_BENCH_HOOK_NONE)
+		ga_bench_hooks_remove();
+	if (ga_bench_regs != NULL && cache != GA_CACHE_NONE)
+		ga_bench_cache_remove();
+	vfree(ga_bench_regs);
+	kfree(cpus);
+	kfree(t);
+	return ret;
+}
+
+/******************************************************************************/
+static void __exit ga_bench_exit(void)
+{
+	printk(KERN_INFO "ga_bench: module exit version %s\n", DRIVER_VERSION);
+}
+
+/******************************************************************************/
+module_init(ga_bench_init);
+module_exit(ga_bench_exit);
+
+/******************************************************************************/
+MODULE_AUTHOR("babytech@126.com");
+MODULE_DESCRIPTION("Generic access contention benchmark");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ga_bench");
+MODULE_VERSION(DRIVER_VERSION);
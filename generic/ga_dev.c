@@ -0,0 +1,378 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *
+*******************************************************************************/
+#define DRIVER_VERSION		"1.1"
+
+/* /dev/ga: batched register access from userspace through generic_access.
+ *
+ * Unlike /dev/mem, the accesses take the same locks as the kernel drivers, and
+ * a whole sequence of reads and (read/update/)writes costs one system call.
+ * See ga_ioctl.h for the interface. Regions are mapped per open file and
+ * unmapped on close. Opening requires CAP_SYS_RAWIO (as /dev/mem does), and
+ * only device memory is mapped: no RAM and no range a driver claimed
+ * exclusively (as /dev/mem with STRICT_DEVMEM).
+ * A file can also sample registers periodically, the samples are read().
+ */
+
+#include <linux/module.h>   /* Needed by all modules */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/io.h>
+#include <linux/ioport.h>
+#include <linux/mm.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/capability.h>
+#include "generic_access.h"
+#include "ga_ioctl.h"
+
+/******************************************************************************/
+struct ga_dev_region {
+	void __iomem	*base;		/* NULL if the slot is free */
+	u64		size;
+};
+
+struct ga_dev_file {
+	struct mutex		lock;	/* serializes the ioctls of one file */
+	struct ga_dev_region	regions[GA_IOC_MAX_REGIONS];
+	struct ga_ioc_op	*uops;	/* GA_IOC_MAX_OPS, copy of the user vector */
+	struct ga_reg_op	*ops;	/* GA_IOC_MAX_OPS, passed to ga_reg_batch */
+	struct rw_semaphore	sampler_sem;	/* read() vs. freeing the sampler, the
+						 * reads are serialized by the sampler */
+	struct ga_sampler	*sampler;
+};
+
+/******************************************************************************/
+static int ga_dev_check_range(const struct ga_ioc_region *r)
+{
+	u64 last = r->addr + r->size - 1;
+
+	if ((r->size == 0) || (last < r->addr))
+		return -EINVAL;
+	/* phys_addr_t and size_t are 32-bit on 32-bit kernels without LPAE */
+	if (((phys_addr_t)last != last) || ((size_t)r->size != r->size))
+		return -EINVAL;
+
+	if (region_intersects(r->addr, r->size, IORESOURCE_SYSTEM_RAM,
+			IORES_DESC_NONE) != REGION_DISJOINT)
+		return -EPERM;
+	if (region_intersects(r->addr, r->size, IORESOURCE_MEM | IORESOURCE_EXCLUSIVE,
+			IORES_DESC_NONE) != REGION_DISJOINT)
+		return -EPERM;
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_dev_map(struct ga_dev_file *f, struct ga_ioc_region __user *arg)
+{
+	struct ga_ioc_region	r;
+	int			id;
+	int			ret;
+
+	if (copy_from_user(&r, arg, sizeof(r)))
+		return -EFAULT;
+	ret = ga_dev_check_range(&r);
+	if (ret)
+		return ret;
+
+	for (id = 0; id < GA_IOC_MAX_REGIONS; id++)
+		if (f->regions[id].base == NULL)
+			break;
+	if (id == GA_IOC_MAX_REGIONS)
+		return -ENOSPC;
+
+	f->regions[id].base = ioremap(r.addr, r.size);
+	if (f->regions[id].base == NULL)
+		return -ENOMEM;
+	f->regions[id].size = r.size;
+
+	r.id = id;
+	if (copy_to_user(arg, &r, sizeof(r))) {
+		iounmap(f->regions[id].base);
+		f->regions[id].base = NULL;
+		return -EFAULT;
+	}
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_dev_unmap(struct ga_dev_file *f, u32 __user *arg)
+{
+	u32 id;
+
+	if (get_user(id, arg))
+		return -EFAULT;
+	if ((id >= GA_IOC_MAX_REGIONS) || (f->regions[id].base == NULL))
+		return -EINVAL;
+	if (f->sampler != NULL)
+		return -EBUSY;
+
+	iounmap(f->regions[id].base);
+	f->regions[id].base = NULL;
+	return 0;
+}
+
+/******************************************************************************/
+/* Translate an operation of userspace, the access has to be within the region */
+static int ga_dev_op(struct ga_dev_file *f, const struct ga_ioc_op *uop, struct ga_reg_op *op)
+{
+	const struct ga_dev_region	*region;
+	unsigned int			bytes = uop->size / 8;
+
+	if ((uop->region >= GA_IOC_MAX_REGIONS) || (f->regions[uop->region].base == NULL))
+		return -EINVAL;
+	if ((uop->size != 8) && (uop->size != 16) && (uop->size != 32) && (uop->size != 64))
+		return -EINVAL;
+
+	region = &f->regions[uop->region];
+	if ((uop->offset & (bytes - 1)) || ((u64)uop->offset + bytes > region->size))
+		return -EINVAL;
+
+	op->addr = region->base + uop->offset;
+	op->size = uop->size;
+	op->op = uop->op;
+	op->mask = uop->mask;
+	op->value = uop->value;
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_dev_batch(struct ga_dev_file *f, struct ga_ioc_batch __user *arg)
+{
+	struct ga_ioc_batch	b;
+	struct ga_ioc_op __user	*uops;
+	int			i, ret;
+
+	if (copy_from_user(&b, arg, sizeof(b)))
+		return -EFAULT;
+	if ((b.count == 0) || (b.count > GA_IOC_MAX_OPS))
+		return -EINVAL;
+
+	uops = u64_to_user_ptr(b.ops);
+	if (copy_from_user(f->uops, uops, b.count * sizeof(*f->uops)))
+		return -EFAULT;
+
+	for (i = 0; i < b.count; i++) {
+		ret = ga_dev_op(f, &f->uops[i], &f->ops[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	/* Nothing is executed when one of the operations is invalid */
+	ret = ga_reg_batch(f->ops, b.count);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < b.count; i++) {
+		f->uops[i].result = f->ops[i].result;
+		f->uops[i].modified = f->ops[i].modified;
+	}
+	if (copy_to_user(uops, f->uops, b.count * sizeof(*f->uops)))
+		return -EFAULT;
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_dev_sample_start(struct ga_dev_file *f, struct ga_ioc_sample __user *arg)
+{
+	struct ga_ioc_sample	smp;
+	int			i, ret;
+
+	if (copy_from_user(&smp, arg, sizeof(smp)))
+		return -EFAULT;
+	if ((smp.count == 0) || (smp.count > GA_IOC_MAX_OPS))
+		return -EINVAL;
+	if (f->sampler != NULL)
+		return -EBUSY;
+
+	if (copy_from_user(f->uops, u64_to_user_ptr(smp.ops), smp.count * sizeof(*f->uops)))
+		return -EFAULT;
+	for (i = 0; i < smp.count; i++) {
+		ret = ga_dev_op(f, &f->uops[i], &f->ops[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	down_write(&f->sampler_sem);
+	ret = ga_sampler_start(f->ops, smp.count, smp.period_ns, smp.rows, &f->sampler);
+	up_write(&f->sampler_sem);
+	return ret;
+}
+
+/* Readers blocked in read() return once the sampler is stopped */
+static int ga_dev_sample_stop(struct ga_dev_file *f)
+{
+	if (f->sampler == NULL)
+		return -EINVAL;
+
+	ga_sampler_stop(f->sampler);
+	down_write(&f->sampler_sem);
+	ga_sampler_free(f->sampler);
+	f->sampler = NULL;
+	up_write(&f->sampler_sem);
+	return 0;
+}
+
+/******************************************************************************/
+static ssize_t ga_dev_read(struct file *filp, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct ga_dev_file	*f = filp->private_data;
+	ssize_t			ret = -EINVAL;
+
+	down_read(&f->sampler_sem);
+	if (f->sampler != NULL)
+		ret = ga_sampler_read(f->sampler, buf, count, filp->f_flags & O_NONBLOCK);
+	up_read(&f->sampler_sem);
+	return ret;
+}
+
+/******************************************************************************/
+static long ga_dev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct ga_dev_file	*f = filp->private_data;
+	int			ret;
+
+	mutex_lock(&f->lock);
+	switch (cmd) {
+	case GA_IOC_MAP:
+		ret = ga_dev_map(f, (struct ga_ioc_region __user *)arg);
+		break;
+	case GA_IOC_UNMAP:
+		ret = ga_dev_unmap(f, (u32 __user *)arg);
+		break;
+	case GA_IOC_BATCH:
+		ret = ga_dev_batch(f, (struct ga_ioc_batch __user *)arg);
+		break;
+	case GA_IOC_SAMPLE_START:
+		ret = ga_dev_sample_start(f, (struct ga_ioc_sample __user *)arg);
+		break;
+	case GA_IOC_SAMPLE_STOP:
+		ret = ga_dev_sample_stop(f);
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+	mutex_unlock(&f->lock);
+	return ret;
+}
+
+/******************************************************************************/
+static int ga_dev_open(struct inode *inode, struct file *filp)
+{
+	struct ga_dev_file *f;
+
+	if (!capable(CAP_SYS_RAWIO))
+		return -EPERM;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (f == NULL)
+		return -ENOMEM;
+
+	f->uops = kcalloc(GA_IOC_MAX_OPS, sizeof(*f->uops), GFP_KERNEL);
+	f->ops = kcalloc(GA_IOC_MAX_OPS, sizeof(*f->ops), GFP_KERNEL);
+	if ((f->uops == NULL) || (f->ops == NULL)) {
+		kfree(f->uops);
+		kfree(f->ops);
+		kfree(f);
+		return -ENOMEM;
+	}
+	mutex_init(&f->lock);
+	init_rwsem(&f->sampler_sem);
+
+	filp->private_data = f;
+	return 0;
+}
+
+/******************************************************************************/
+static int ga_dev_release(struct inode *inode, struct file *filp)
+{
+	struct ga_dev_file	*f = filp->private_data;
+	int			id;
+
+	if (f->sampler != NULL) {
+		ga_sampler_stop(f->sampler);
+		ga_sampler_free(f->sampler);
+	}
+	for (id = 0; id < GA_IOC_MAX_REGIONS; id++)
+		if (f->regions[id].base != NULL)
+			iounmap(f->regions[id].base);
+
+	kfree(f->uops);
+	kfree(f->ops);
+	kfree(f);
+	return 0;
+}
+
+/******************************************************************************/
+static const struct file_operations ga_dev_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ga_dev_open,
+	.release	= ga_dev_release,
+	.read		= ga_dev_read,
+	.unlocked_ioctl	= ga_dev_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.llseek		= no_llseek,
+};
+
+static struct miscdevice ga_dev_misc = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "ga",
+	.fops		= &ga_dev_fops,
+};
+
+/******************************************************************************
+ * Module initializations
+ ******************************************************************************/
+static int __init ga_dev_init(void)
+{
+	int ret;
+
+	printk(KERN_INFO "ga_dev: module init version %s\n", DRIVER_VERSION);
+
+	BUILD_BUG_ON(GA_IOC_OP_READ != GA_READ);
+	BUILD_BUG_ON(GA_IOC_OP_WRITE != GA_WRITE);
+	BUILD_BUG_ON(GA_IOC_OP_READ_WRITE_CONDITIONAL != GA_READ_WRITE_CONDITIONAL);
+	BUILD_BUG_ON(GA_IOC_OP_READ_WRITE_ALWAYS != GA_READ_WRITE_ALWAYS);
+	BUILD_BUG_ON(GA_IOC_MAX_OPS > GA_SAMPLER_MAX_OPS);
+
+	ret = misc_register(&ga_dev_misc);
+	if (ret)
+		printk(KERN_ERR "ga_dev: register misc device failed\n");
+	return ret;
+}
+
+/******************************************************************************/
+static void __exit ga_dev_exit(void)
+{
+	printk(KERN_INFO "ga_dev: module exit version %s\n", DRIVER_VERSION);
+	misc_deregister(&ga_dev_misc);
+}
+
+/******************************************************************************/
+module_init(ga_dev_init);
+module_exit(ga_dev_exit);
+
+/******************************************************************************/
+MODULE_AUTHOR("babytech@126.com");
+MODULE_DESCRIPTION("Batched register access from userspace");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ga_dev");
+MODULE_VERSION(DRIVER_VERSION);
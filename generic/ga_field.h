@@ -0,0 +1,135 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef KERNEL_GA_FIELD_H
+#define KERNEL_GA_FIELD_H
+
+/* Register fields for drivers with a fixed register map, declared once (at file
+ * scope) with their offset, width and shift:
+ *
+ *   GA_REG(ctrl, 0x10, 8);			8-bit register at offset 0x10
+ *   GA_FIELD(ctrl, enable, 0, 1);		bit 0
+ *   GA_FIELD(ctrl, mode, 4, 3);		bits 6:4
+ *
+ *   ga_field_write(base, ctrl, mode, 5);	ga_reg_write8(base + 0x10, 0x70, 0x50, GA_WRITE_DEFAULT)
+ *   mode = ga_field_read(base, ctrl, mode);	ga_reg_read8(base + 0x10, 0x70) >> 4
+ *
+ * The accessors call the ga_reg_readN/ga_reg_writeN of the register width with
+ * constant masks, and a write of all bits is demoted to GA_WRITE at compile
+ * time. The offset is relative to the base passed to the accessors, which may
+ * itself come from the device tree (the watchdog kick register is declared at
+ * offset 0). The masks and values go through <linux/bitfield.h>: a misaligned
+ * offset and a field which does not fit in its register fail the static_assert
+ * of their declaration, a constant value which does not fit in its field fails
+ * FIELD_PREP.
+ * Several fields of a register are written at once with ga_reg_write_fields:
+ *
+ *   ga_reg_write_fields(base, ctrl, GA_FIELD_MASK(ctrl, enable) | GA_FIELD_MASK(ctrl, mode),
+ *       GA_FIELD_PREP(ctrl, enable, 1) | GA_FIELD_PREP(ctrl, mode, 5));
+ *
+ * Masks which come from the device tree (e.g. the led reg_mask) keep using
+ * ga_reg_writeX with runtime masks.
+ */
+#include <linux/types.h>
+#include <linux/bits.h>
+#include <linux/bitfield.h>
+#include <linux/build_bug.h>
+#include "generic_access.h"
+
+/******************************************************************************/
+/* Declare register '__reg' at '__offset' (in bytes), '__width' is 8, 16, 32 or 64 */
+#define GA_REG(__reg, __offset, __width)						\
+	enum {										\
+		__ga_reg_##__reg##_offset = (__offset),					\
+		__ga_reg_##__reg##_width = (__width),					\
+	};										\
+	static_assert(((__offset) % ((__width) / 8)) == 0,				\
+		"GA_REG(" #__reg "): offset not aligned on the width");			\
+	typedef u##__width __ga_reg_##__reg##_t;					\
+											\
+	static __always_inline __ga_reg_##__reg##_t					\
+	__ga_reg_##__reg##_read(void __iomem *base, __ga_reg_##__reg##_t mask)		\
+	{										\
+		return ga_reg_read##__width(base + (__offset), mask);			\
+	}										\
+											\
+	static __always_inline int							\
+	__ga_reg_##__reg##_write(void __iomem *base, __ga_reg_##__reg##_t mask,		\
+		__ga_reg_##__reg##_t value, int options)				\
+	{										\
+		/* Constant masks: the demotion is decided by the compiler */		\
+		if (mask == (__ga_reg_##__reg##_t)~0ULL)				\
+			options = GA_WRITE;						\
+		return ga_reg_write##__width(base + (__offset), mask, value, options);	\
+	}
+
+/* Declare field '__field' of register '__reg': '__bits' bits from bit '__shift' */
+#define GA_FIELD(__reg, __field, __shift, __bits)					\
+	enum {										\
+		__ga_field_##__reg##_##__field##_shift = (__shift),			\
+		__ga_field_##__reg##_##__field##_bits = (__bits),			\
+	};										\
+	static_assert(((__bits) > 0) && ((__shift) >= 0) &&				\
+		((__shift) + (__bits) <= __ga_reg_##__reg##_width),			\
+		"GA_FIELD(" #__reg ", " #__field "): does not fit in the register")
+
+/******************************************************************************/
+/* Mask of a field in its register, largest value of a field */
+#define GA_FIELD_MASK(__reg, __field)							\
+	((__ga_reg_##__reg##_t)GENMASK_ULL(__ga_field_##__reg##_##__field##_shift +	\
+		__ga_field_##__reg##_##__field##_bits - 1, __ga_field_##__reg##_##__field##_shift))
+
+#define GA_FIELD_MAX(__reg, __field)							\
+	((__ga_reg_##__reg##_t)FIELD_MAX(GA_FIELD_MASK(__reg, __field)))
+
+/* Field value shifted into place (a constant value has to fit in the field) */
+#define GA_FIELD_PREP(__reg, __field, __val)						\
+	((__ga_reg_##__reg##_t)FIELD_PREP(GA_FIELD_MASK(__reg, __field), __val))
+
+/* Field value from a register value */
+#define GA_FIELD_GET(__reg, __field, __regval)						\
+	((__ga_reg_##__reg##_t)FIELD_GET(GA_FIELD_MASK(__reg, __field), __regval))
+
+/******************************************************************************/
+/* Whole register */
+#define ga_reg_read_fields(__base, __reg, __mask)					\
+	__ga_reg_##__reg##_read(__base, __mask)
+
+#define ga_reg_write_fields(__base, __reg, __mask, __value)				\
+	__ga_reg_##__reg##_write(__base, __mask, __value, GA_WRITE_DEFAULT)
+
+/* One field, ga_field_write_options takes the GA_WRITE/GA_READ_WRITE_XXX option */
+#define ga_field_read(__base, __reg, __field)						\
+	GA_FIELD_GET(__reg, __field, __ga_reg_##__reg##_read(__base, GA_FIELD_MASK(__reg, __field)))
+
+#define ga_field_write_options(__base, __reg, __field, __val, __options)		\
+	__ga_reg_##__reg##_write(__base, GA_FIELD_MASK(__reg, __field), GA_FIELD_PREP(__reg, __field, __val), __options)
+
+#define ga_field_write(__base, __reg, __field, __val)					\
+	ga_field_write_options(__base, __reg, __field, __val, GA_WRITE_DEFAULT)
+
+/* Descriptors for ga_reg_batch, the 'result' of a read is the masked register
+ * value (see GA_FIELD_GET)
+ */
+#define GA_FIELD_OP_READ(__base, __reg, __field)					\
+	GA_REG_OP((__base) + __ga_reg_##__reg##_offset, __ga_reg_##__reg##_width, GA_READ, GA_FIELD_MASK(__reg, __field), 0)
+
+#define GA_FIELD_OP_WRITE(__base, __reg, __field, __val)				\
+	GA_REG_OP((__base) + __ga_reg_##__reg##_offset, __ga_reg_##__reg##_width,	\
+		GA_FIELD_MASK(__reg, __field) == (__ga_reg_##__reg##_t)~0ULL ? GA_WRITE : GA_WRITE_DEFAULT, \
+		GA_FIELD_MASK(__reg, __field), GA_FIELD_PREP(__reg, __field, __val))
+
+#endif
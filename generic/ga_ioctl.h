@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GA_IOCTL_H
+#define GA_IOCTL_H
+
+/* Interface of /dev/ga (ga_dev.ko), shared with userspace.
+ *
+ * A region of registers is first mapped with GA_IOC_MAP, which returns its id.
+ * It fails with EPERM if the region overlaps RAM or a range a driver claimed
+ * exclusively, EINVAL if it wraps or does not fit the physical address space.
+ * GA_IOC_BATCH then executes a vector of operations on the mapped regions with
+ * ga_reg_batch(), so in one system call and under the same locks the kernel
+ * drivers use. The results are copied back into the vector.
+ *
+ * GA_IOC_SAMPLE_START starts reading a vector of GA_IOC_OP_READ operations
+ * every 'period_ns' in the kernel (ga_sampler_start), one sampler per file.
+ * read() then returns whole rows of (2 + count) __u64: the time of the sample
+ * (CLOCK_MONOTONIC ns), its sequence number (a gap means dropped samples) and
+ * the masked values in the order of the operations. read() waits for a quarter
+ * of the ring (unless O_NONBLOCK) and returns 0 once GA_IOC_SAMPLE_STOP was
+ * called and all rows were read. Regions cannot be unmapped while sampling.
+ */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* Operations, same values as GA_READ, GA_WRITE and GA_READ_WRITE_XXX */
+#define GA_IOC_OP_READ			0x00
+#define GA_IOC_OP_WRITE			0x01
+#define GA_IOC_OP_READ_WRITE_CONDITIONAL	0x02
+#define GA_IOC_OP_READ_WRITE_ALWAYS	0x04
+
+#define GA_IOC_MAX_REGIONS	16
+#define GA_IOC_MAX_OPS		128
+
+struct ga_ioc_region {
+	__u64	addr;		/* in: physical address */
+	__u64	size;		/* in: size in bytes */
+	__u32	id;		/* out: region id */
+	__u32	reserved;
+};
+
+struct ga_ioc_op {
+	__u32	region;		/* region id */
+	__u32	offset;		/* offset in the region, aligned to the access size */
+	__u8	size;		/* access size: 8, 16, 32 or 64 */
+	__u8	op;		/* GA_IOC_OP_XXX */
+	__u16	reserved;
+	__u32	modified;	/* out: GA_MODIFIED_XXX of a write */
+	__u64	mask;
+	__u64	value;		/* value to write */
+	__u64	result;		/* out: value read */
+};
+
+struct ga_ioc_batch {
+	__u64	ops;		/* pointer to an array of struct ga_ioc_op */
+	__u32	count;		/* at most GA_IOC_MAX_OPS */
+	__u32	reserved;
+};
+
+struct ga_ioc_sample {
+	__u64	ops;		/* pointer to an array of struct ga_ioc_op (reads) */
+	__u32	count;		/* at most GA_IOC_MAX_OPS */
+	__u32	rows;		/* rows in the ring, rounded up to a power of 2 */
+	__u64	period_ns;	/* at least 10000 */
+};
+
+#define GA_IOC_MAGIC	'G'
+#define GA_IOC_MAP	_IOWR(GA_IOC_MAGIC, 1, struct ga_ioc_region)
+#define GA_IOC_UNMAP	_IOW(GA_IOC_MAGIC, 2, __u32)
+#define GA_IOC_BATCH	_IOW(GA_IOC_MAGIC, 3, struct ga_ioc_batch)
+#define GA_IOC_SAMPLE_START	_IOW(GA_IOC_MAGIC, 4, struct ga_ioc_sample)
+#define GA_IOC_SAMPLE_STOP	_IO(GA_IOC_MAGIC, 5)
+
+#endif
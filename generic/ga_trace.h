@@ -0,0 +1,81 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GA_TRACE_H
+#define GA_TRACE_H
+
+/* Layout of the register access trace of generic_access (debugfs
+ * generic_access/trace), shared with userspace (test_suite/ga_trace_decode.c).
+ *
+ * The file can be read or mmap'ed. It starts with struct ga_trace_header,
+ * followed by one ring per cpu at sizeof(header) + cpu * ring_size. A ring is
+ * struct ga_trace_ring followed by 'entries' entries: entry i of a ring is
+ * written at index (i & (entries - 1)), so the last min(head, entries) entries
+ * are available, or all of them once head has wrapped. Each cpu only writes its
+ * own ring; stop the trace (debugfs generic_access/trace_enable) before reading
+ * it for a consistent snapshot.
+ *
+ * head is 32 bit so that it is never torn on 32 bit cpus: the writer stores it
+ * with release semantics after the entry, a reader loads it with acquire
+ * semantics before the entries. It wraps after 2^32 entries, which wraps
+ * counts.
+ */
+#include <linux/types.h>
+
+#define GA_TRACE_MAGIC		0x52544147	/* "GATR" */
+#define GA_TRACE_VERSION	2
+
+/* Types of accesses */
+#define GA_TRACE_READ		0	/* ga_reg_readX */
+#define GA_TRACE_WRITE		1	/* GA_WRITE (or full mask): no read first */
+#define GA_TRACE_RMW		2	/* read/update/write, written */
+#define GA_TRACE_RMW_SKIPPED	3	/* GA_READ_WRITE_CONDITIONAL, not written */
+
+/* Flags */
+#define GA_TRACE_F_CACHED	0x01	/* 'old' came from the shadow cache */
+#define GA_TRACE_F_LOCKLESS	0x02	/* ga_reg_readX_lockless */
+
+struct ga_trace_header {
+	__u32	magic;
+	__u32	version;
+	__u32	cpus;		/* number of rings */
+	__u32	entries;	/* entries per ring, a power of 2 */
+	__u32	entry_size;	/* sizeof(struct ga_trace_entry) */
+	__u32	ring_size;	/* bytes per ring, header included */
+	__u64	reserved[5];
+};
+
+struct ga_trace_ring {
+	__u32	head;		/* entries written since the trace was enabled, mod 2^32 */
+	__u32	wraps;		/* times head wrapped to 0 */
+	__u64	reserved[7];
+};
+
+struct ga_trace_entry {
+	__u64	timestamp;	/* ns (local_clock of the cpu) */
+	__u64	addr;		/* ioremap'ed address of the register */
+	__u64	caller;		/* return address in the calling driver */
+	__u64	mask;
+	__u64	old;		/* value read (not masked), 0 for GA_TRACE_WRITE */
+	__u64	new;		/* value written, 0 for GA_TRACE_READ */
+	__u32	cpu;
+	__u8	width;		/* access size: 8, 16, 32 or 64 */
+	__u8	type;		/* GA_TRACE_XXX */
+	__u8	flags;		/* GA_TRACE_F_XXX */
+	__u8	reserved[9];
+};
+
+#endif
@@ -15,23 +15,286 @@
  *
  *
 *******************************************************************************/
-#define DRIVER_VERSION		"1.5"
+#define DRIVER_VERSION		"2.8"
 
 #include <linux/module.h>   /* Needed by all modules */
 #include <linux/types.h>
 #include <linux/io.h>
 #include <linux/mm.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/bitmap.h>
+#include <linux/lockdep.h>
+#include <linux/slab.h>
+#include <linux/jump_label.h>
+#include <linux/rbtree_latch.h>
+#include <linux/srcu.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/wait.h>
+#include <linux/uaccess.h>
+#include <asm/unaligned.h>
+#include <linux/percpu.h>
+#include <linux/sched/clock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
 #include "generic_access.h"
+#include "ga_trace.h"
 
-/* Lock to protect access to the hardware within the any kernel driver.
+/* Locks to protect access to the hardware within the any kernel driver.
  * Note that this does not protect against accesses from userspace, but ideally
  * there is a clear responsability split between userspace access and
  * kernelspace access.
+ *
+ * The locks are striped: the lock protecting a register is selected by hashing
+ * the page the register lives in. All registers of an ioremap'ed block of
+ * registers therefore share one lock, while unrelated devices (mapped on
+ * different pages) do not contend with each other.
+ *
+ * In GA_LM_SPINLOCK mode, every writer also bumps the seqcount of the lock, so
+ * ga_reg_readX_lockless can read a register without taking the lock: the read
+ * is simply repeated when a write to a register of the same lock was in flight.
+ */
+#define GA_LOCK_BITS	6
+#define GA_LOCK_COUNT	(1 << GA_LOCK_BITS)
+
+struct ga_lock {
+	spinlock_t	spinlock;
+	struct mutex	mutex;
+	seqcount_t	seq;
+} ____cacheline_aligned_in_smp;
+
+static struct ga_lock ga_locks[GA_LOCK_COUNT];
+
+/* Every stripe has its own lock class, so lockdep accepts that ga_reg_batch()
+ * nests stripes (always in ascending index order).
+ */
+static struct lock_class_key ga_spinlock_keys[GA_LOCK_COUNT];
+static struct lock_class_key ga_mutex_keys[GA_LOCK_COUNT];
+
+/******************************************************************************/
+/* Access statistics, per cpu and only collected while ga_stats_active is on
+ * (module parameter 'stats' or debugfs generic_access/enable). The lock wait
+ * and hold times are log2 histograms: bucket i counts the times in
+ * [2^(i-1), 2^i) ns, the last bucket everything above.
+ */
+enum ga_stat {
+	GA_STAT_READ8,
+	GA_STAT_READ16,
+	GA_STAT_READ32,
+	GA_STAT_READ64,
+	GA_STAT_WRITE8,
+	GA_STAT_WRITE16,
+	GA_STAT_WRITE32,
+	GA_STAT_WRITE64,
+	GA_STAT_WRITE_SKIPPED,	/* GA_READ_WRITE_CONDITIONAL without write */
+	GA_STAT_HOOK,		/* accesses handled by a hook */
+	GA_STAT_CACHE_HIT,	/* reads served by the shadow cache */
+	GA_STAT_LOCKLESS,	/* reads without lock */
+	GA_STAT_LOCKLESS_RETRY,	/* lockless reads repeated due to a write */
+	GA_STAT_COPY_TO_BYTES,	/* ga_memcpy_toio */
+	GA_STAT_COPY_TO_NS,
+	GA_STAT_COPY_FROM_BYTES,	/* ga_memcpy_fromio */
+	GA_STAT_COPY_FROM_NS,
+	GA_STAT_POSTED,		/* writes queued by ga_posted_init */
+	GA_STAT_POSTED_COALESCED,	/* queued writes replaced by a later one */
+	GA_STAT_COUNT
+};
+
+static const char * const ga_stat_names[GA_STAT_COUNT] = {
+	"read8", "read16", "read32", "read64",
+	"write8", "write16", "write32", "write64",
+	"write_skipped", "hook", "cache_hit",
+	"lockless", "lockless_retry",
+	"copy_to_bytes", "copy_to_ns", "copy_from_bytes", "copy_from_ns",
+	"posted", "posted_coalesced",
+};
+
+#define GA_HIST_BUCKETS	32
+
+struct ga_stats {
+	u64	count[GA_STAT_COUNT];
+	u64	lock_wait[GA_HIST_BUCKETS];
+	u64	lock_hold[GA_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct ga_stats, ga_stats);
+static DEFINE_STATIC_KEY_FALSE(ga_stats_active);
+
+static int stats = 0;
+module_param(stats, int, 0444);
+MODULE_PARM_DESC(stats, "Collect access statistics from the start (see debugfs generic_access/)");
+
+#define ga_stat_inc(__s)								\
+	do {										\
+		if (static_branch_unlikely(&ga_stats_active))				\
+			this_cpu_inc(ga_stats.count[__s]);				\
+	} while (0)
+
+#define ga_stat_add(__s,__n)								\
+	do {										\
+		if (static_branch_unlikely(&ga_stats_active))				\
+			this_cpu_add(ga_stats.count[__s], __n);				\
+	} while (0)
+
+/* Statistic of a read or write of type __T */
+#define GA_STAT_READ(__T)	(GA_STAT_READ8 + ilog2(sizeof(__T)))
+#define GA_STAT_WRITE(__T)	(GA_STAT_WRITE8 + ilog2(sizeof(__T)))
+
+static inline unsigned int ga_hist_bucket(u64 ns)
+{
+	return min_t(unsigned int, fls64(ns), GA_HIST_BUCKETS - 1);
+}
+
+/* Returns the current time when statistics are collected, 0 otherwise.
+ * Called before taking a lock, it returns the start of the wait.
+ */
+static __always_inline u64 ga_stats_clock(void)
+{
+	return static_branch_unlikely(&ga_stats_active) ? local_clock() : 0;
+}
+
+/* Called once the lock is taken, returns the start of the hold */
+static __always_inline u64 ga_stats_lock_taken(u64 start)
+{
+	u64 now;
+
+	if (!static_branch_unlikely(&ga_stats_active) || (start == 0))
+		return 0;
+	now = local_clock();
+	this_cpu_inc(ga_stats.lock_wait[ga_hist_bucket(now - start)]);
+	return now;
+}
+
+/* Called before releasing the lock */
+static __always_inline void ga_stats_lock_release(u64 taken)
+{
+	if (!static_branch_unlikely(&ga_stats_active) || (taken == 0))
+		return;
+	this_cpu_inc(ga_stats.lock_hold[ga_hist_bucket(local_clock() - taken)]);
+}
+
+/******************************************************************************/
+/* Access trace (debugfs generic_access/trace, layout in ga_trace.h): one ring
+ * per cpu in a vmalloc'ed buffer which userspace can mmap, allocated when the
+ * trace is first enabled. Accesses are only recorded while ga_trace_active is
+ * on, with the caller passed down from the exported functions.
  */
-DEFINE_SPINLOCK(ga_spinlock);
-DEFINE_MUTEX(ga_mutex);
+static DEFINE_STATIC_KEY_FALSE(ga_trace_active);
+static DEFINE_MUTEX(ga_trace_mutex);
+static void *ga_trace_buf;
+static size_t ga_trace_size;
+static size_t ga_trace_ring_size;
+static unsigned int ga_trace_entries;
+
+static int trace_entries = 4096;
+module_param(trace_entries, int, 0444);
+MODULE_PARM_DESC(trace_entries, "Entries per cpu of the access trace (rounded up to a power of 2)");
+
+static struct ga_trace_ring *ga_trace_ring(int cpu)
+{
+	return ga_trace_buf + sizeof(struct ga_trace_header) + cpu * ga_trace_ring_size;
+}
+
+/* Each cpu only writes its own ring, interrupts off */
+static noinline void ga_trace_record(int type, int flags, const volatile void __iomem *addr, int width,
+	u64 mask, u64 old, u64 new, unsigned long caller)
+{
+	struct ga_trace_ring	*ring;
+	struct ga_trace_entry	*e;
+	unsigned long		irqflags;
+	u32			head;
+	int			cpu;
+
+	local_irq_save(irqflags);
+	cpu = smp_processor_id();
+	ring = ga_trace_ring(cpu);
+	head = ring->head;
+	e = (struct ga_trace_entry *)(ring + 1) + (head & (ga_trace_entries - 1));
+	e->timestamp = local_clock();
+	e->addr = (unsigned long)addr;
+	e->caller = caller;
+	e->mask = mask;
+	e->old = old;
+	e->new = new;
+	e->cpu = cpu;
+	e->width = width;
+	e->type = type;
+	e->flags = flags;
+	if (unlikely(head + 1 == 0))
+		WRITE_ONCE(ring->wraps, ring->wraps + 1);
+	smp_store_release(&ring->head, head + 1); /* entry before head */
+	local_irq_restore(irqflags);
+}
+
+#define ga_trace(__type,__flags,__addr,__T,__mask,__old,__new,__caller)			\
+	do {										\
+		if (static_branch_unlikely(&ga_trace_active))				\
+			ga_trace_record(__type, __flags, __addr, sizeof(__T) * 8, __mask, __old, __new, __caller); \
+	} while (0)
 
 /******************************************************************************/
+/* Hooked regions are looked up by (ioremap'ed) virtual address, so no page
+ * table walk is needed to match an access against them. Regions never overlap,
+ * which makes a latched rbtree sufficient as interval structure: lookups are
+ * lockless and safe against concurrent insertion and removal. Readers hold
+ * ga_regions_srcu (SRCU since hooks may sleep in GA_LM_MUTEX mode), updaters
+ * hold ga_regions_mutex.
+ *
+ * As long as no hooks are installed, ga_hooks_active is off and an access only
+ * costs a static branch. The same holds for ga_cache_active and the shadow
+ * caches.
+ */
+
+/* Shadow cache of a region: one state byte per register byte. The state holds
+ * the GA_CACHE_XXX policy and, once a value is known, GA_CACHE_VALID. The first
+ * byte of the last access also records the access size, used by ga_cache_sync.
+ * Cached values are protected by the lock of the register.
+ */
+#define GA_CACHE_POLICY_MASK	0x03
+#define GA_CACHE_VALID		0x04
+#define GA_CACHE_START		0x08 /* First byte of a register */
+#define GA_CACHE_WIDTH_SHIFT	4    /* log2 of the register size in bytes */
+
+struct ga_cache {
+	u8			*shadow;	/* last known values, NULL if not cached */
+	u8			*state;
+};
+
+struct ga_posted;
+
+struct ga_region {
+	struct latch_tree_node	node;
+	struct list_head	list;	/* ga_region_list, used by the updaters */
+	unsigned long		start;	/* ioremap'ed address */
+	unsigned long		size;
+	phys_addr_t		addr;	/* physical address passed to the hooks */
+	void			*opaque;
+	struct ga_ioaddr_ops	ops;
+	bool			hooked;	/* at least one hook is set */
+	struct ga_cache		cache;
+	struct ga_posted	*posted;	/* posted writes, NULL if not posted */
+};
+
+static struct latch_tree_root ga_regions;
+static LIST_HEAD(ga_region_list);
+static struct ga_region *ga_ioaddr_region; /* installed by ga_set_ioaddr_ops */
+static DEFINE_MUTEX(ga_regions_mutex);
+DEFINE_STATIC_SRCU(ga_regions_srcu);
+static DEFINE_STATIC_KEY_FALSE(ga_hooks_active);
+static DEFINE_STATIC_KEY_FALSE(ga_cache_active);
+
+/* Legacy hooks installed by physical address (ga_set_phys_addr_ops) */
 struct ga_ioaddr_info {
 	phys_addr_t		addr;
 	phys_addr_t		size;
@@ -43,17 +306,30 @@ static struct ga_ioaddr_info addr_info;
 static int ga_lock_mode = GA_LM_SPINLOCK;
 
 /******************************************************************************/
-void ga_set_lock_mode(int mode)
+/* Switching while another thread holds or takes a stripe would release it
+ * with the wrong primitive, so the caller must be the only user: every module
+ * linked against generic_access holds a reference on it, the caller included.
+ */
+int ga_set_lock_mode(int mode)
 {
-	ga_lock_mode = mode;
+	if ((mode != GA_LM_SPINLOCK) && (mode != GA_LM_MUTEX))
+		return -EINVAL;
+	if (module_refcount(THIS_MODULE) > 1)
+		return -EBUSY;
+	WRITE_ONCE(ga_lock_mode, mode);
+	return 0;
 }
 EXPORT_SYMBOL_GPL(ga_set_lock_mode);
 
 /******************************************************************************/
 int ga_set_phys_addr_ops(phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque)
 {
+	int was_active = (addr_info.ops.read8 != NULL) || (addr_info.ops.write8 != NULL);
+
 	if (ops == NULL) {
 		memset(&addr_info, 0, sizeof(addr_info));
+		if (was_active)
+			static_branch_dec(&ga_hooks_active);
 		return 0;
 	}
 
@@ -67,219 +343,2258 @@ int ga_set_phys_addr_ops(phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_op
 		int ret = addr_info.ops.init(addr, size, opaque);
 		if (ret) {
 			memset(&addr_info, 0, sizeof(addr_info));
+			if (was_active)
+				static_branch_dec(&ga_hooks_active);
 			return ret;
 		}
 	}
+
+	if (!was_active)
+		static_branch_inc(&ga_hooks_active);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(ga_set_phys_addr_ops);
 
 /******************************************************************************/
-static inline int ga_ioaddr_to_phys(const void __iomem *ioaddr, phys_addr_t *paddr)
+static __always_inline struct ga_region *ga_region_of(struct latch_tree_node *n)
 {
-	struct page	*page;
-	phys_addr_t	addr;
-
-	page = vmalloc_to_page(ioaddr);
-	if (page == NULL)
-		return -EFAULT; /* not a ioremap'ed address */
-
-	addr = page_to_phys(page) + offset_in_page(ioaddr);
-
-	if ((addr >= addr_info.addr) && (addr < addr_info.addr + addr_info.size)) {
-		*paddr = addr;
-		return 1; /* we are in range */
-	}
+	return container_of(n, struct ga_region, node);
+}
 
-	return 0; /* we are not in range */
+static __always_inline bool ga_region_less(struct latch_tree_node *a, struct latch_tree_node *b)
+{
+	return ga_region_of(a)->start < ga_region_of(b)->start;
 }
 
-/******************************************************************************/
-static u8 ga_raw_readb(const void __iomem *ioaddr)
+static __always_inline int ga_region_comp(void *key, struct latch_tree_node *n)
 {
-	if (addr_info.ops.read8 != NULL) {
-		phys_addr_t addr;
-		int ret = ga_ioaddr_to_phys(ioaddr, &addr);
-		if (ret < 0)
-			return 0; /* error */
-		else if (ret > 0)
-			return addr_info.ops.read8(addr, addr_info.opaque); /* address match */
-	}
-	/* No callback or no address match */
-	return __raw_readb(ioaddr);
+	unsigned long		ioaddr = (unsigned long)key;
+	struct ga_region	*region = ga_region_of(n);
+
+	if (ioaddr < region->start)
+		return -1;
+	if (ioaddr >= region->start + region->size)
+		return 1;
+	return 0;
 }
 
+static const struct latch_tree_ops ga_region_tree_ops = {
+	.less = ga_region_less,
+	.comp = ga_region_comp,
+};
+
 /******************************************************************************/
-static void ga_raw_writeb(u8 val, void __iomem *ioaddr)
+/* Must be called within ga_regions_srcu */
+static inline struct ga_region *ga_region_find(const volatile void __iomem *ioaddr)
 {
-	if (addr_info.ops.write8 != NULL) {
-		phys_addr_t addr;
-		int ret = ga_ioaddr_to_phys(ioaddr, &addr);
-		if (ret < 0)
-			return; /* error */
-		else if (ret > 0)
-			return addr_info.ops.write8(val, addr, addr_info.opaque); /* address match */
-	}
-	/* No callback or no address match */
-	__raw_writeb(val, ioaddr);
+	struct latch_tree_node *n;
+
+	n = latch_tree_find((void *)ioaddr, &ga_regions, &ga_region_tree_ops);
+	return n ? ga_region_of(n) : NULL;
 }
 
 /******************************************************************************/
-#define LOCK										\
-	unsigned long flags = 0;							\
-	if (ga_lock_mode == GA_LM_SPINLOCK)						\
-		spin_lock_irqsave(&ga_spinlock, flags);					\
-	else										\
-		mutex_lock(&ga_mutex);
+/* Posted writes (ga_posted_init): the hooked writes of a region are queued and
+ * written to the backend by a worker. A write to a queued register replaces the
+ * queued write, which moves to the tail: the backend sees the last value of
+ * every register, in the order of these last writes. A read of a queued
+ * register is served from the queue, any other read first flushes the queue.
+ *
+ * The queue lock serializes all calls to the hooks of the region (so the worker
+ * does not need the register locks), it nests inside the register locks.
+ */
+#define GA_POSTED_MAX_DEPTH	256
 
-#define UNLOCK										\
-	if (ga_lock_mode == GA_LM_SPINLOCK)						\
-		spin_unlock_irqrestore(&ga_spinlock, flags);				\
-	else										\
-		mutex_unlock(&ga_mutex);
+struct ga_posted_write {
+	unsigned long	off;	/* offset in the region */
+	u64		val;
+	int		bytes;	/* 0 once replaced by a later write */
+};
 
-/******************************************************************************
- * Writing
- ******************************************************************************/
-#define GA_DEFINE_REG_WRITE(__f,__T,__r,__w,__a)					\
-int __f(void __iomem *addr, __T mask, __T value, int options)				\
-{											\
-	int modified = GA_MODIFIED_NONE;						\
-	LOCK;										\
-	if ((options & GA_WRITE) || (mask == __a)) {					\
-		/* We are updating all bits so no need to read first */			\
-		__w(value & mask, addr);						\
-		modified = GA_MODIFIED_MAYBE; /* we are not sure we are modifying */	\
-	}										\
-	else if (options & (GA_READ_WRITE_CONDITIONAL|GA_READ_WRITE_ALWAYS)) {		\
-		/* We are updating specific bits so read first */			\
-		__T old_reg, new_reg;							\
-		new_reg = old_reg = __r(addr);						\
-		new_reg &= ~mask;							\
-		new_reg |= (value & mask);						\
-		if (old_reg != new_reg)							\
-			modified = GA_MODIFIED_SURE; /* we are sure we are modifying */	\
-		/* Only write when we need to write */					\
-		if ((options & GA_READ_WRITE_ALWAYS) || (old_reg != new_reg))		\
-			__w(new_reg, addr);						\
-	}										\
-	UNLOCK;										\
-	return modified;								\
-}											\
-EXPORT_SYMBOL_GPL(__f);
+struct ga_posted {
+	spinlock_t		spinlock;
+	struct mutex		mutex;
+	struct ga_region	*region;
+	struct delayed_work	work;
+	unsigned long		delay;		/* jiffies */
+	unsigned int		depth;
+	unsigned int		tail;		/* used entries, replaced ones included */
+	unsigned int		pending;	/* queued writes */
+	struct ga_posted_write	queue[];
+};
 
-/******************************************************************************/
-GA_DEFINE_REG_WRITE(ga_reg_write8,  u8,  ga_raw_readb, ga_raw_writeb, 0xff)
-GA_DEFINE_REG_WRITE(ga_reg_write16, u16, __raw_readw,  __raw_writew,  0xffff)
-GA_DEFINE_REG_WRITE(ga_reg_write32, u32, __raw_readl,  __raw_writel,  0xffffffffU)
+static inline unsigned long ga_posted_lock(struct ga_posted *posted)
+{
+	unsigned long flags = 0;
 
-#ifdef CONFIG_64BIT
-GA_DEFINE_REG_WRITE(ga_reg_write64, u64, __raw_readq,  __raw_writeq,  0xffffffffffffffffULL)
-#else
-int ga_reg_write64(void __iomem *addr, u64 mask, u64 value, int options)
+	if (ga_lock_mode == GA_LM_SPINLOCK)
+		spin_lock_irqsave(&posted->spinlock, flags);
+	else
+		mutex_lock(&posted->mutex);
+	return flags;
+}
+
+static inline void ga_posted_unlock(struct ga_posted *posted, unsigned long flags)
 {
-#ifdef __LITTLE_ENDIAN
-	/* Least significant first */
-	int rc1 = ga_reg_write32(addr, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options);
-	int rc2 = ga_reg_write32(addr + 4, (u32)(mask >> 32), (u32)(value >> 32), options);
-#else
-	/* Most significant first */
-	int rc1 = ga_reg_write32(addr, (u32)(mask >> 32), (u32)(value >> 32), options);
-	int rc2 = ga_reg_write32(addr + 4, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options);
-#endif
-	if ((rc1 == GA_MODIFIED_SURE) || (rc2 == GA_MODIFIED_SURE))
-		return GA_MODIFIED_SURE;
-	else if ((rc1 == GA_MODIFIED_MAYBE) || (rc2 == GA_MODIFIED_MAYBE))
-		return GA_MODIFIED_MAYBE;
+	if (ga_lock_mode == GA_LM_SPINLOCK)
+		spin_unlock_irqrestore(&posted->spinlock, flags);
 	else
-		return GA_MODIFIED_NONE;
+		mutex_unlock(&posted->mutex);
 }
-#endif
 
 /******************************************************************************/
-int ga_reg_write(void __iomem *addr, int access_size, u64 mask, u64 value, int options)
+/* Calls to the hooks, with the queue lock held. A read returns 0 when there is
+ * no hook for its size (the access then goes to the hardware).
+ */
+static int ga_posted_hook_read(struct ga_region *region, unsigned long off, u64 *val, int bytes)
 {
-	/* Handle write operation */
-	switch (access_size) {
-	case 8:
-		ga_reg_write8(addr, (u8)mask, (u8)value, options);
+	phys_addr_t addr = region->addr + off;
+
+	switch (bytes) {
+	case 1:
+		if (region->ops.read8 == NULL)
+			return 0;
+		*val = region->ops.read8(addr, region->opaque);
 		break;
-	case 16:
-		ga_reg_write16(addr, (u16)mask, (u16)value, options);
+	case 2:
+		if (region->ops.read16 == NULL)
+			return 0;
+		*val = region->ops.read16(addr, region->opaque);
 		break;
-	case 32:
-		ga_reg_write32(addr, (u32)mask, (u32)value, options);
+	case 4:
+		if (region->ops.read32 == NULL)
+			return 0;
+		*val = region->ops.read32(addr, region->opaque);
 		break;
-	case 64:
-		ga_reg_write64(addr, (u64)mask, (u64)value, options);
+#ifdef CONFIG_64BIT
+	case 8:
+		if (region->ops.read64 == NULL)
+			return 0;
+		*val = region->ops.read64(addr, region->opaque);
 		break;
+#endif
 	default:
-		return -EINVAL;
+		return 0;
 	}
-	return 0;
+	ga_stat_inc(GA_STAT_HOOK);
+	return 1;
 }
-EXPORT_SYMBOL_GPL(ga_reg_write);
 
-/******************************************************************************
- * Reading
- ******************************************************************************/
-#define GA_DEFINE_REG_READ(__f,__T,__r)							\
-__T __f(void __iomem *addr, __T mask)							\
-{											\
-	__T reg;									\
-	LOCK;										\
-	reg = __r(addr) & mask;								\
-	UNLOCK;										\
-	return reg;									\
-}											\
-EXPORT_SYMBOL_GPL(__f);
+/* Only writes with a hook are queued */
+static void ga_posted_hook_write(struct ga_region *region, unsigned long off, u64 val, int bytes)
+{
+	phys_addr_t addr = region->addr + off;
+
+	switch (bytes) {
+	case 1:
+		region->ops.write8((u8)val, addr, region->opaque);
+		break;
+	case 2:
+		region->ops.write16((u16)val, addr, region->opaque);
+		break;
+	case 4:
+		region->ops.write32((u32)val, addr, region->opaque);
+		break;
+#ifdef CONFIG_64BIT
+	case 8:
+		region->ops.write64(val, addr, region->opaque);
+		break;
+#endif
+	}
+	ga_stat_inc(GA_STAT_HOOK);
+}
 
 /******************************************************************************/
-GA_DEFINE_REG_READ(ga_reg_read8,  u8,  ga_raw_readb)
-GA_DEFINE_REG_READ(ga_reg_read16, u16, __raw_readw)
-GA_DEFINE_REG_READ(ga_reg_read32, u32, __raw_readl)
+static void ga_posted_flush_locked(struct ga_posted *posted)
+{
+	unsigned int i;
 
-#ifdef CONFIG_64BIT
-GA_DEFINE_REG_READ(ga_reg_read64, u64, __raw_readq)
-#else
-u64 ga_reg_read64(void __iomem *addr, u64 mask)
+	for (i = 0; i < posted->tail; i++) {
+		const struct ga_posted_write *w = &posted->queue[i];
+		if (w->bytes != 0)
+			ga_posted_hook_write(posted->region, w->off, w->val, w->bytes);
+	}
+	posted->tail = 0;
+	posted->pending = 0;
+}
+
+static void ga_posted_flush(struct ga_posted *posted)
 {
-#ifdef __LITTLE_ENDIAN
-	/* Least significant first */
-	u64 lsv = (u64)ga_reg_read32(addr, (u32)(mask & 0x00000000ffffffffULL));
-	u64 msv = (u64)ga_reg_read32(addr + 4, (u32)(mask >> 32));
-#else
-	/* Most significant first */
-	u64 msv = (u64)ga_reg_read32(addr, (u32)(mask >> 32));
-	u64 lsv = (u64)ga_reg_read32(addr + 4, (u32)(mask & 0x00000000ffffffffULL));
-#endif
-	return (msv << 32) & lsv;
+	unsigned long flags = ga_posted_lock(posted);
+
+	ga_posted_flush_locked(posted);
+	ga_posted_unlock(posted, flags);
+}
+
+static void ga_posted_work(struct work_struct *work)
+{
+	ga_posted_flush(container_of(to_delayed_work(work), struct ga_posted, work));
+}
+
+/* Remove the replaced entries */
+static void ga_posted_compact(struct ga_posted *posted)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < posted->tail; i++)
+		if (posted->queue[i].bytes != 0)
+			posted->queue[n++] = posted->queue[i];
+	posted->tail = n;
 }
-#endif
 
 /******************************************************************************/
-int ga_reg_read(void __iomem *addr, int access_size, u64 mask, u64 *value)
+/* Queue a hooked write, called with the lock of the register held */
+static noinline void ga_posted_write(struct ga_posted *posted, unsigned long off, u64 val, int bytes)
 {
-	/* Handle read operation */
-	switch (access_size) {
-	case 8:
-		*value = (u64)ga_reg_read8(addr, (u8)mask);
-		break;
-	case 16:
-		*value = (u64)ga_reg_read16(addr, (u16)mask);
-		break;
-	case 32:
-		*value = (u64)ga_reg_read32(addr, (u32)mask);
+	unsigned long	flags = ga_posted_lock(posted);
+	int		i;
+
+	ga_stat_inc(GA_STAT_POSTED);
+	for (i = (int)posted->tail - 1; i >= 0; i--) {
+		struct ga_posted_write *w = &posted->queue[i];
+		if ((w->off != off) || (w->bytes != bytes))
+			continue;
+		ga_stat_inc(GA_STAT_POSTED_COALESCED);
+		if (i == (int)posted->tail - 1) {
+			w->val = val; /* already the last write */
+			goto out;
+		}
+		w->bytes = 0;
+		posted->pending--;
 		break;
-	case 64:
-		*value = (u64)ga_reg_read64(addr, (u64)mask);
+	}
+
+	/* A full queue is written by the writer which fills it */
+	if ((posted->tail == posted->depth) && (posted->pending < posted->depth))
+		ga_posted_compact(posted);
+	if (posted->tail == posted->depth)
+		ga_posted_flush_locked(posted);
+
+	posted->queue[posted->tail].off = off;
+	posted->queue[posted->tail].val = val;
+	posted->queue[posted->tail].bytes = bytes;
+	posted->tail++;
+	if (posted->pending++ == 0)
+		schedule_delayed_work(&posted->work, posted->delay);
+out:
+	ga_posted_unlock(posted, flags);
+}
+
+/* Read after the queued writes. Returns 1 when the read was handled (served
+ * from the queue or by a hook).
+ */
+static noinline int ga_posted_read(struct ga_region *region, struct ga_posted *posted, unsigned long off,
+	u64 *val, int bytes)
+{
+	unsigned long	flags = ga_posted_lock(posted);
+	int		i, ret = 1;
+
+	/* The last queued write overlapping the register, if it is the register */
+	for (i = (int)posted->tail - 1; i >= 0; i--) {
+		const struct ga_posted_write *w = &posted->queue[i];
+		if ((w->bytes == 0) || (w->off + w->bytes <= off) || (off + bytes <= w->off))
+			continue;
+		if ((w->off == off) && (w->bytes == bytes)) {
+			*val = w->val;
+			goto out;
+		}
 		break;
-	default:
+	}
+
+	ga_posted_flush_locked(posted);
+	ret = ga_posted_hook_read(region, off, val, bytes);
+out:
+	ga_posted_unlock(posted, flags);
+	return ret;
+}
+
+/******************************************************************************/
+int ga_posted_init(void __iomem *ioaddr, unsigned int depth, unsigned int delay_us)
+{
+	struct ga_region	*region, *found = NULL;
+	struct ga_posted	*posted;
+	int			ret = 0;
+
+	if ((depth == 0) || (depth > GA_POSTED_MAX_DEPTH))
 		return -EINVAL;
+
+	mutex_lock(&ga_regions_mutex);
+	list_for_each_entry(region, &ga_region_list, list) {
+		if (region->start == (unsigned long)ioaddr) {
+			found = region;
+			break;
+		}
+	}
+	if ((found == NULL) || !found->hooked) {
+		ret = -ENOENT;
+		goto out;
+	}
+	if (found->posted != NULL) {
+		ret = -EBUSY;
+		goto out;
 	}
+
+	posted = kzalloc(sizeof(*posted) + depth * sizeof(posted->queue[0]), GFP_KERNEL);
+	if (posted == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	spin_lock_init(&posted->spinlock);
+	mutex_init(&posted->mutex);
+	INIT_DELAYED_WORK(&posted->work, ga_posted_work);
+	posted->region = found;
+	posted->delay = usecs_to_jiffies(delay_us);
+	posted->depth = depth;
+	smp_store_release(&found->posted, posted);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_posted_init);
+
+/******************************************************************************/
+int ga_flush(void __iomem *ioaddr)
+{
+	struct ga_region	*region;
+	struct ga_posted	*posted;
+	int			idx;
+
+	idx = srcu_read_lock(&ga_regions_srcu);
+	region = ga_region_find(ioaddr);
+	if (region != NULL) {
+		posted = READ_ONCE(region->posted);
+		if (posted != NULL)
+			ga_posted_flush(posted);
+	}
+	srcu_read_unlock(&ga_regions_srcu, idx);
 	return 0;
 }
-EXPORT_SYMBOL_GPL(ga_reg_read);
+EXPORT_SYMBOL_GPL(ga_flush);
+
+/******************************************************************************/
+/* Must be called with ga_regions_mutex held */
+static int ga_region_overlaps(unsigned long start, unsigned long size, struct ga_region *ignore)
+{
+	struct ga_region *region;
+
+	list_for_each_entry(region, &ga_region_list, list) {
+		if (region == ignore)
+			continue;
+		if ((start < region->start + region->size) && (region->start < start + size))
+			return 1;
+	}
+	return 0;
+}
+
+/******************************************************************************/
+/* Must be called with ga_regions_mutex held */
+static int ga_region_create(void __iomem *ioaddr, phys_addr_t addr, phys_addr_t size,
+	struct ga_ioaddr_ops *ops, void *opaque, struct ga_region **pregion)
+{
+	struct ga_region *region;
+
+	if (size == 0)
+		return -EINVAL;
+
+	region = kzalloc(sizeof(*region), GFP_KERNEL);
+	if (region == NULL)
+		return -ENOMEM;
+
+	region->start = (unsigned long)ioaddr;
+	region->size = size;
+	region->addr = addr;
+	region->opaque = opaque;
+	region->ops = *ops;
+	region->hooked = ops->read8 || ops->read16 || ops->read32 || ops->read64 ||
+		ops->write8 || ops->write16 || ops->write32 || ops->write64;
+
+	/* Call init function (if any) */
+	if (region->ops.init != NULL) {
+		int ret = region->ops.init(addr, size, opaque);
+		if (ret) {
+			kfree(region);
+			return ret;
+		}
+	}
+
+	*pregion = region;
+	return 0;
+}
+
+/******************************************************************************/
+/* Must be called with ga_regions_mutex held */
+static void ga_region_insert(struct ga_region *region)
+{
+	list_add_tail(&region->list, &ga_region_list);
+	latch_tree_insert(&region->node, &ga_regions, &ga_region_tree_ops);
+	if (region->hooked)
+		static_branch_inc(&ga_hooks_active);
+	if (region->cache.shadow != NULL)
+		static_branch_inc(&ga_cache_active);
+}
+
+/* Must be called with ga_regions_mutex held. Free after synchronize_srcu() */
+static void ga_region_remove(struct ga_region *region)
+{
+	if (region->hooked)
+		static_branch_dec(&ga_hooks_active);
+	if (region->cache.shadow != NULL)
+		static_branch_dec(&ga_cache_active);
+	latch_tree_erase(&region->node, &ga_regions, &ga_region_tree_ops);
+	list_del(&region->list);
+	if (region == ga_ioaddr_region)
+		ga_ioaddr_region = NULL;
+}
+
+static void ga_region_free(struct ga_region *region)
+{
+	if (region->posted != NULL) {
+		/* The queued writes still go to the backend */
+		cancel_delayed_work_sync(&region->posted->work);
+		ga_posted_flush(region->posted);
+		kfree(region->posted);
+	}
+	kfree(region->cache.shadow);
+	kfree(region);
+}
+
+/******************************************************************************/
+int ga_add_ioaddr_ops(void __iomem *ioaddr, phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque)
+{
+	struct ga_region	*region;
+	int			ret;
+
+	if (ops == NULL)
+		return -EINVAL;
+
+	mutex_lock(&ga_regions_mutex);
+	if (ga_region_overlaps((unsigned long)ioaddr, size, NULL)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	ret = ga_region_create(ioaddr, addr, size, ops, opaque, &region);
+	if (ret == 0)
+		ga_region_insert(region);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_add_ioaddr_ops);
+
+/******************************************************************************/
+int ga_remove_ioaddr_ops(void __iomem *ioaddr)
+{
+	struct ga_region *region, *found = NULL;
+
+	mutex_lock(&ga_regions_mutex);
+	list_for_each_entry(region, &ga_region_list, list) {
+		if (region->start == (unsigned long)ioaddr) {
+			found = region;
+			ga_region_remove(found);
+			break;
+		}
+	}
+	mutex_unlock(&ga_regions_mutex);
+
+	if (found == NULL)
+		return -ENOENT;
+
+	/* Wait until no access uses the hooks anymore */
+	synchronize_srcu(&ga_regions_srcu);
+	ga_region_free(found);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_remove_ioaddr_ops);
+
+/******************************************************************************/
+int ga_set_ioaddr_ops(void __iomem *ioaddr, phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque)
+{
+	struct ga_region	*region = NULL;
+	struct ga_region	*old;
+	int			ret = 0;
+
+	mutex_lock(&ga_regions_mutex);
+	old = ga_ioaddr_region;
+	if (ops != NULL) {
+		if (ga_region_overlaps((unsigned long)ioaddr, size, old)) {
+			ret = -EBUSY;
+			goto out;
+		}
+		ret = ga_region_create(ioaddr, addr, size, ops, opaque, &region);
+		if (ret)
+			goto out;
+	}
+	if (old != NULL)
+		ga_region_remove(old);
+	if (region != NULL) {
+		ga_region_insert(region);
+		ga_ioaddr_region = region;
+	}
+out:
+	mutex_unlock(&ga_regions_mutex);
+
+	/* Wait until no access uses the old hooks anymore */
+	if ((ret == 0) && (old != NULL)) {
+		synchronize_srcu(&ga_regions_srcu);
+		ga_region_free(old);
+	}
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_set_ioaddr_ops);
+
+/******************************************************************************/
+static inline int ga_ioaddr_to_phys(const void __iomem *ioaddr, phys_addr_t *paddr)
+{
+	struct page	*page;
+	phys_addr_t	addr;
+
+	page = vmalloc_to_page(ioaddr);
+	if (page == NULL)
+		return -EFAULT; /* not a ioremap'ed address */
+
+	addr = page_to_phys(page) + offset_in_page(ioaddr);
+
+	if ((addr >= addr_info.addr) && (addr < addr_info.addr + addr_info.size)) {
+		*paddr = addr;
+		return 1; /* we are in range */
+	}
+
+	return 0; /* we are not in range */
+}
+
+/******************************************************************************/
+/* Dispatch an access to the hooks of the region it falls in (if any).
+ * Returns 1 when a hook handled the access.
+ */
+#define GA_DEFINE_HOOKED_READ(__f,__T,__hook)						\
+static noinline int __f(const void __iomem *ioaddr, __T *val)				\
+{											\
+	struct ga_region	*region;						\
+	struct ga_posted	*posted;						\
+	int			idx, ret = 0;						\
+											\
+	idx = srcu_read_lock(&ga_regions_srcu);						\
+	region = ga_region_find(ioaddr);						\
+	posted = region ? READ_ONCE(region->posted) : NULL;				\
+	if (posted != NULL) {								\
+		u64 v;									\
+		ret = ga_posted_read(region, posted, (unsigned long)ioaddr - region->start, &v, sizeof(__T)); \
+		*val = (__T)v;								\
+	}										\
+	else if ((region != NULL) && (region->ops.__hook != NULL)) {			\
+		*val = region->ops.__hook(region->addr + ((unsigned long)ioaddr - region->start), region->opaque); \
+		ga_stat_inc(GA_STAT_HOOK);						\
+		ret = 1;								\
+	}										\
+	srcu_read_unlock(&ga_regions_srcu, idx);					\
+	return ret;									\
+}
+
+#define GA_DEFINE_HOOKED_WRITE(__f,__T,__hook)						\
+static noinline int __f(__T val, void __iomem *ioaddr)					\
+{											\
+	struct ga_region	*region;						\
+	struct ga_posted	*posted;						\
+	int			idx, ret = 0;						\
+											\
+	idx = srcu_read_lock(&ga_regions_srcu);						\
+	region = ga_region_find(ioaddr);						\
+	posted = region ? READ_ONCE(region->posted) : NULL;				\
+	if ((region != NULL) && (region->ops.__hook != NULL)) {				\
+		if (posted != NULL)							\
+			ga_posted_write(posted, (unsigned long)ioaddr - region->start, val, sizeof(__T)); \
+		else {									\
+			region->ops.__hook(val, region->addr + ((unsigned long)ioaddr - region->start), region->opaque); \
+			ga_stat_inc(GA_STAT_HOOK);					\
+		}									\
+		ret = 1;								\
+	}										\
+	else if (posted != NULL)							\
+		ga_posted_flush(posted); /* to the hardware after the queued writes */	\
+	srcu_read_unlock(&ga_regions_srcu, idx);					\
+	return ret;									\
+}
+
+/* Raw accessors: a static branch, unless hooks are installed */
+#define GA_DEFINE_RAW_READ(__f,__T,__r,__hooked)					\
+static inline __T __f(const void __iomem *ioaddr)					\
+{											\
+	__T val;									\
+	if (static_branch_unlikely(&ga_hooks_active) && __hooked(ioaddr, &val))		\
+		return val;								\
+	/* No callback or no address match */						\
+	return __r(ioaddr);								\
+}
+
+#define GA_DEFINE_RAW_WRITE(__f,__T,__w,__hooked)					\
+static inline void __f(__T val, void __iomem *ioaddr)					\
+{											\
+	if (static_branch_unlikely(&ga_hooks_active) && __hooked(val, ioaddr))		\
+		return;									\
+	/* No callback or no address match */						\
+	__w(val, ioaddr);								\
+}
+
+/******************************************************************************/
+GA_DEFINE_HOOKED_READ(ga_hooked_readb_region, u8,  read8)
+GA_DEFINE_HOOKED_READ(ga_hooked_readw, u16, read16)
+GA_DEFINE_HOOKED_READ(ga_hooked_readl, u32, read32)
+GA_DEFINE_HOOKED_WRITE(ga_hooked_writeb_region, u8,  write8)
+GA_DEFINE_HOOKED_WRITE(ga_hooked_writew, u16, write16)
+GA_DEFINE_HOOKED_WRITE(ga_hooked_writel, u32, write32)
+#ifdef CONFIG_64BIT
+GA_DEFINE_HOOKED_READ(ga_hooked_readq, u64, read64)
+GA_DEFINE_HOOKED_WRITE(ga_hooked_writeq, u64, write64)
+#endif
+
+/******************************************************************************/
+/* 8-bit accesses can also be hooked by physical address (ga_set_phys_addr_ops) */
+static noinline int ga_hooked_readb(const void __iomem *ioaddr, u8 *val)
+{
+	int ret = ga_hooked_readb_region(ioaddr, val);
+
+	if ((ret == 0) && (addr_info.ops.read8 != NULL)) {
+		phys_addr_t addr;
+		ret = ga_ioaddr_to_phys(ioaddr, &addr);
+		if (ret < 0)
+			*val = 0; /* error */
+		else if (ret > 0) {
+			*val = addr_info.ops.read8(addr, addr_info.opaque); /* address match */
+			ga_stat_inc(GA_STAT_HOOK);
+		}
+	}
+	return ret;
+}
+
+static noinline int ga_hooked_writeb(u8 val, void __iomem *ioaddr)
+{
+	int ret = ga_hooked_writeb_region(val, ioaddr);
+
+	if ((ret == 0) && (addr_info.ops.write8 != NULL)) {
+		phys_addr_t addr;
+		ret = ga_ioaddr_to_phys(ioaddr, &addr);
+		if (ret > 0) {
+			addr_info.ops.write8(val, addr, addr_info.opaque); /* address match */
+			ga_stat_inc(GA_STAT_HOOK);
+		}
+	}
+	return ret;
+}
+
+/* The lockless reads only go straight to plain MMIO. A register of a region
+ * (hooks, posted writes, cache) or under the physical address hooks takes the
+ * locked path: the hooks stay serialized against the writers and are not
+ * called again by a retry.
+ */
+static inline bool ga_reg_hooked(const void __iomem *ioaddr)
+{
+	bool	hooked;
+	int	idx;
+
+	if (!static_branch_unlikely(&ga_hooks_active))
+		return false;
+	if ((addr_info.ops.read8 != NULL) || (addr_info.ops.write8 != NULL))
+		return true;
+	idx = srcu_read_lock(&ga_regions_srcu);
+	hooked = ga_region_find(ioaddr) != NULL;
+	srcu_read_unlock(&ga_regions_srcu, idx);
+	return hooked;
+}
+
+/******************************************************************************/
+GA_DEFINE_RAW_READ(ga_raw_readb, u8,  __raw_readb, ga_hooked_readb)
+GA_DEFINE_RAW_READ(ga_raw_readw, u16, __raw_readw, ga_hooked_readw)
+GA_DEFINE_RAW_READ(ga_raw_readl, u32, __raw_readl, ga_hooked_readl)
+GA_DEFINE_RAW_WRITE(ga_raw_writeb, u8,  __raw_writeb, ga_hooked_writeb)
+GA_DEFINE_RAW_WRITE(ga_raw_writew, u16, __raw_writew, ga_hooked_writew)
+GA_DEFINE_RAW_WRITE(ga_raw_writel, u32, __raw_writel, ga_hooked_writel)
+#ifdef CONFIG_64BIT
+GA_DEFINE_RAW_READ(ga_raw_readq, u64, __raw_readq, ga_hooked_readq)
+GA_DEFINE_RAW_WRITE(ga_raw_writeq, u64, __raw_writeq, ga_hooked_writeq)
+#endif
+
+/******************************************************************************/
+/* Shadow cache lookup, called with the lock of the register held.
+ * Returns 1 when the cached value of the register is valid and may be used
+ * for 'policy' (GA_CACHE_WRITE: read back of a read/update/write,
+ * GA_CACHE_READ_WRITE: read).
+ */
+static noinline int ga_cache_lookup(const void __iomem *ioaddr, void *val, int bytes, int policy)
+{
+	struct ga_region	*region;
+	unsigned long		off;
+	int			i, idx, ret = 0;
+
+	idx = srcu_read_lock(&ga_regions_srcu);
+	region = ga_region_find(ioaddr);
+	if ((region == NULL) || (region->cache.shadow == NULL))
+		goto out;
+
+	off = (unsigned long)ioaddr - region->start;
+	if (off + bytes > region->size)
+		goto out;
+	for (i = 0; i < bytes; i++) {
+		u8 state = region->cache.state[off + i];
+		if (!(state & GA_CACHE_VALID) || ((state & GA_CACHE_POLICY_MASK) < policy))
+			goto out;
+	}
+	memcpy(val, region->cache.shadow + off, bytes);
+	ga_stat_inc(GA_STAT_CACHE_HIT);
+	ret = 1;
+out:
+	srcu_read_unlock(&ga_regions_srcu, idx);
+	return ret;
+}
+
+/* Record the value which was read from or written to the hardware */
+static noinline void ga_cache_update(const void __iomem *ioaddr, const void *val, int bytes)
+{
+	struct ga_region	*region;
+	unsigned long		off;
+	u8			*state;
+	int			i, idx;
+
+	idx = srcu_read_lock(&ga_regions_srcu);
+	region = ga_region_find(ioaddr);
+	if ((region == NULL) || (region->cache.shadow == NULL))
+		goto out;
+
+	off = (unsigned long)ioaddr - region->start;
+	state = region->cache.state + off;
+	if ((off + bytes > region->size) || ((*state & GA_CACHE_POLICY_MASK) == GA_CACHE_NONE))
+		goto out;
+
+	memcpy(region->cache.shadow + off, val, bytes);
+	for (i = 0; i < bytes; i++)
+		state[i] = (state[i] & GA_CACHE_POLICY_MASK) | GA_CACHE_VALID;
+	state[0] |= GA_CACHE_START | (ilog2(bytes) << GA_CACHE_WIDTH_SHIFT);
+out:
+	srcu_read_unlock(&ga_regions_srcu, idx);
+}
+
+#define ga_cache_get(__addr,__pval,__policy)						\
+	(static_branch_unlikely(&ga_cache_active) && ga_cache_lookup(__addr, __pval, sizeof(*(__pval)), __policy))
+
+#define ga_cache_put(__addr,__pval)							\
+	do {										\
+		if (static_branch_unlikely(&ga_cache_active))				\
+			ga_cache_update(__addr, __pval, sizeof(*(__pval)));		\
+	} while (0)
+
+/******************************************************************************/
+static inline unsigned int ga_lock_index(const volatile void __iomem *ioaddr)
+{
+	return hash_long((unsigned long)ioaddr >> PAGE_SHIFT, GA_LOCK_BITS);
+}
+
+static inline struct ga_lock *ga_lock_get(const volatile void __iomem *ioaddr)
+{
+	return &ga_locks[ga_lock_index(ioaddr)];
+}
+
+/******************************************************************************/
+#define LOCK(__addr)									\
+	struct ga_lock *lock = ga_lock_get(__addr);					\
+	unsigned long flags = 0;							\
+	u64 lock_time = ga_stats_clock();						\
+	if (ga_lock_mode == GA_LM_SPINLOCK)						\
+		spin_lock_irqsave(&lock->spinlock, flags);				\
+	else										\
+		mutex_lock(&lock->mutex);						\
+	lock_time = ga_stats_lock_taken(lock_time);
+
+#define UNLOCK										\
+	ga_stats_lock_release(lock_time);						\
+	if (ga_lock_mode == GA_LM_SPINLOCK)						\
+		spin_unlock_irqrestore(&lock->spinlock, flags);				\
+	else										\
+		mutex_unlock(&lock->mutex);
+
+/* Writers hold the lock. The seqcount is only maintained in GA_LM_SPINLOCK
+ * mode, where the writers cannot be preempted.
+ */
+static __always_inline void ga_write_begin(struct ga_lock *lock)
+{
+	if (ga_lock_mode == GA_LM_SPINLOCK)
+		write_seqcount_begin(&lock->seq);
+}
+
+static __always_inline void ga_write_end(struct ga_lock *lock)
+{
+	if (ga_lock_mode == GA_LM_SPINLOCK)
+		write_seqcount_end(&lock->seq);
+}
+
+/******************************************************************************
+ * Writing
+ ******************************************************************************/
+/* __f##_locked is called with the lock held, 'caller' is recorded in the trace */
+#define GA_DEFINE_REG_WRITE(__f,__T,__r,__w,__a)					\
+static int __f##_locked(void __iomem *addr, __T mask, __T value, int options,		\
+	unsigned long caller)								\
+{											\
+	int modified = GA_MODIFIED_NONE;						\
+	ga_stat_inc(GA_STAT_WRITE(__T));						\
+	if ((options & GA_WRITE) || (mask == __a)) {					\
+		/* We are updating all bits so no need to read first */			\
+		__T new_reg = value & mask;						\
+		__w(new_reg, addr);							\
+		ga_cache_put(addr, &new_reg);						\
+		ga_trace(GA_TRACE_WRITE, 0, addr, __T, mask, 0, new_reg, caller);	\
+		modified = GA_MODIFIED_MAYBE; /* we are not sure we are modifying */	\
+	}										\
+	else if (options & (GA_READ_WRITE_CONDITIONAL|GA_READ_WRITE_ALWAYS)) {		\
+		/* We are updating specific bits so read first (or use the cache) */	\
+		__T old_reg, new_reg;							\
+		int cached = ga_cache_get(addr, &old_reg, GA_CACHE_WRITE);		\
+		if (!cached)								\
+			old_reg = __r(addr);						\
+		new_reg = old_reg;							\
+		new_reg &= ~mask;							\
+		new_reg |= (value & mask);						\
+		if (old_reg != new_reg)							\
+			modified = GA_MODIFIED_SURE; /* we are sure we are modifying */	\
+		/* Only write when we need to write */					\
+		if ((options & GA_READ_WRITE_ALWAYS) || (old_reg != new_reg)) {		\
+			__w(new_reg, addr);						\
+			ga_trace(GA_TRACE_RMW, cached ? GA_TRACE_F_CACHED : 0, addr, __T, mask, old_reg, new_reg, caller); \
+		}									\
+		else {									\
+			ga_stat_inc(GA_STAT_WRITE_SKIPPED);				\
+			ga_trace(GA_TRACE_RMW_SKIPPED, cached ? GA_TRACE_F_CACHED : 0, addr, __T, mask, old_reg, new_reg, caller); \
+		}									\
+		ga_cache_put(addr, &new_reg);						\
+	}										\
+	return modified;								\
+}											\
+											\
+static __always_inline int __f##_caller(void __iomem *addr, __T mask, __T value,	\
+	int options, unsigned long caller)						\
+{											\
+	int modified;									\
+	LOCK(addr);									\
+	ga_write_begin(lock);								\
+	modified = __f##_locked(addr, mask, value, options, caller);			\
+	ga_write_end(lock);								\
+	UNLOCK;										\
+	return modified;								\
+}											\
+											\
+int __f(void __iomem *addr, __T mask, __T value, int options)				\
+{											\
+	return __f##_caller(addr, mask, value, options, _RET_IP_);			\
+}											\
+EXPORT_SYMBOL_GPL(__f);
+
+/******************************************************************************/
+static inline int ga_modified_combine(int rc1, int rc2)
+{
+	if ((rc1 == GA_MODIFIED_SURE) || (rc2 == GA_MODIFIED_SURE))
+		return GA_MODIFIED_SURE;
+	else if ((rc1 == GA_MODIFIED_MAYBE) || (rc2 == GA_MODIFIED_MAYBE))
+		return GA_MODIFIED_MAYBE;
+	else
+		return GA_MODIFIED_NONE;
+}
+
+/******************************************************************************/
+GA_DEFINE_REG_WRITE(ga_reg_write8,  u8,  ga_raw_readb, ga_raw_writeb, 0xff)
+GA_DEFINE_REG_WRITE(ga_reg_write16, u16, ga_raw_readw, ga_raw_writew, 0xffff)
+GA_DEFINE_REG_WRITE(ga_reg_write32, u32, ga_raw_readl, ga_raw_writel, 0xffffffffU)
+
+#ifdef CONFIG_64BIT
+GA_DEFINE_REG_WRITE(ga_reg_write64, u64, ga_raw_readq, ga_raw_writeq, 0xffffffffffffffffULL)
+#else
+/* The caller holds the locks of both halves */
+static int ga_reg_write64_locked(void __iomem *addr, u64 mask, u64 value, int options, unsigned long caller)
+{
+#ifdef __LITTLE_ENDIAN
+	/* Least significant first */
+	int rc1 = ga_reg_write32_locked(addr, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options, caller);
+	int rc2 = ga_reg_write32_locked(addr + 4, (u32)(mask >> 32), (u32)(value >> 32), options, caller);
+#else
+	/* Most significant first */
+	int rc1 = ga_reg_write32_locked(addr, (u32)(mask >> 32), (u32)(value >> 32), options, caller);
+	int rc2 = ga_reg_write32_locked(addr + 4, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options, caller);
+#endif
+	return ga_modified_combine(rc1, rc2);
+}
+
+/* A register crossing a page: the halves are written under their own lock */
+static int ga_reg_write64_split(void __iomem *addr, u64 mask, u64 value, int options, unsigned long caller)
+{
+#ifdef __LITTLE_ENDIAN
+	int rc1 = ga_reg_write32_caller(addr, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options, caller);
+	int rc2 = ga_reg_write32_caller(addr + 4, (u32)(mask >> 32), (u32)(value >> 32), options, caller);
+#else
+	int rc1 = ga_reg_write32_caller(addr, (u32)(mask >> 32), (u32)(value >> 32), options, caller);
+	int rc2 = ga_reg_write32_caller(addr + 4, (u32)(mask & 0x00000000ffffffffULL), (u32)(value & 0x00000000ffffffffU), options, caller);
+#endif
+	return ga_modified_combine(rc1, rc2);
+}
+
+/* Both halves are written within one lock and seqcount section, so neither
+ * ga_reg_read64 nor ga_reg_read64_lockless can see half of the write.
+ */
+static int ga_reg_write64_caller(void __iomem *addr, u64 mask, u64 value, int options, unsigned long caller)
+{
+	int modified;
+
+	if (ga_lock_get(addr) != ga_lock_get(addr + 4))
+		return ga_reg_write64_split(addr, mask, value, options, caller);
+
+	{
+		LOCK(addr);
+		ga_write_begin(lock);
+		modified = ga_reg_write64_locked(addr, mask, value, options, caller);
+		ga_write_end(lock);
+		UNLOCK;
+	}
+	return modified;
+}
+
+int ga_reg_write64(void __iomem *addr, u64 mask, u64 value, int options)
+{
+	return ga_reg_write64_caller(addr, mask, value, options, _RET_IP_);
+}
+EXPORT_SYMBOL_GPL(ga_reg_write64);
+#endif
+
+/******************************************************************************/
+int ga_reg_write(void __iomem *addr, int access_size, u64 mask, u64 value, int options)
+{
+	/* Handle write operation */
+	switch (access_size) {
+	case 8:
+		ga_reg_write8_caller(addr, (u8)mask, (u8)value, options, _RET_IP_);
+		break;
+	case 16:
+		ga_reg_write16_caller(addr, (u16)mask, (u16)value, options, _RET_IP_);
+		break;
+	case 32:
+		ga_reg_write32_caller(addr, (u32)mask, (u32)value, options, _RET_IP_);
+		break;
+	case 64:
+		ga_reg_write64_caller(addr, (u64)mask, (u64)value, options, _RET_IP_);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_reg_write);
+
+/******************************************************************************
+ * Reading
+ ******************************************************************************/
+#define GA_DEFINE_REG_READ(__f,__T,__r)							\
+static inline __T __f##_locked(void __iomem *addr, __T mask, unsigned long caller)	\
+{											\
+	__T reg;									\
+	int cached;									\
+	ga_stat_inc(GA_STAT_READ(__T));							\
+	cached = ga_cache_get(addr, &reg, GA_CACHE_READ_WRITE);				\
+	if (!cached) {									\
+		reg = __r(addr);							\
+		ga_cache_put(addr, &reg);						\
+	}										\
+	ga_trace(GA_TRACE_READ, cached ? GA_TRACE_F_CACHED : 0, addr, __T, mask, reg, 0, caller); \
+	return reg & mask;								\
+}											\
+											\
+static __always_inline __T __f##_caller(void __iomem *addr, __T mask, unsigned long caller) \
+{											\
+	__T reg;									\
+	LOCK(addr);									\
+	reg = __f##_locked(addr, mask, caller);						\
+	UNLOCK;										\
+	return reg;									\
+}											\
+											\
+__T __f(void __iomem *addr, __T mask)							\
+{											\
+	return __f##_caller(addr, mask, _RET_IP_);					\
+}											\
+EXPORT_SYMBOL_GPL(__f);									\
+											\
+__T __f##_lockless(void __iomem *addr, __T mask)					\
+{											\
+	struct ga_lock	*lock = ga_lock_get(addr);					\
+	unsigned int	seq;								\
+	__T		reg;								\
+	if ((ga_lock_mode != GA_LM_SPINLOCK) || ga_reg_hooked(addr))			\
+		return __f##_caller(addr, mask, _RET_IP_);				\
+	ga_stat_inc(GA_STAT_READ(__T));							\
+	ga_stat_inc(GA_STAT_LOCKLESS);							\
+	for (;;) {									\
+		seq = read_seqcount_begin(&lock->seq);					\
+		reg = __r(addr);							\
+		if (!read_seqcount_retry(&lock->seq, seq))				\
+			break;								\
+		ga_stat_inc(GA_STAT_LOCKLESS_RETRY);					\
+	}										\
+	ga_trace(GA_TRACE_READ, GA_TRACE_F_LOCKLESS, addr, __T, mask, reg, 0, _RET_IP_); \
+	return reg & mask;								\
+}											\
+EXPORT_SYMBOL_GPL(__f##_lockless);
+
+/******************************************************************************/
+GA_DEFINE_REG_READ(ga_reg_read8,  u8,  ga_raw_readb)
+GA_DEFINE_REG_READ(ga_reg_read16, u16, ga_raw_readw)
+GA_DEFINE_REG_READ(ga_reg_read32, u32, ga_raw_readl)
+
+#ifdef CONFIG_64BIT
+GA_DEFINE_REG_READ(ga_reg_read64, u64, ga_raw_readq)
+#else
+/* The caller holds the locks of both halves */
+static u64 ga_reg_read64_locked(void __iomem *addr, u64 mask, unsigned long caller)
+{
+#ifdef __LITTLE_ENDIAN
+	/* Least significant first */
+	u64 lsv = (u64)ga_reg_read32_locked(addr, (u32)(mask & 0x00000000ffffffffULL), caller);
+	u64 msv = (u64)ga_reg_read32_locked(addr + 4, (u32)(mask >> 32), caller);
+#else
+	/* Most significant first */
+	u64 msv = (u64)ga_reg_read32_locked(addr, (u32)(mask >> 32), caller);
+	u64 lsv = (u64)ga_reg_read32_locked(addr + 4, (u32)(mask & 0x00000000ffffffffULL), caller);
+#endif
+	return (msv << 32) | lsv;
+}
+
+/* Both halves are read under one lock, so a write through generic_access is
+ * never seen halfway. This does not help for registers the hardware updates
+ * itself, see ga_reg_read64_counter.
+ */
+static u64 ga_reg_read64_caller(void __iomem *addr, u64 mask, unsigned long caller)
+{
+	u64 lsv, msv;
+
+	if (ga_lock_get(addr) == ga_lock_get(addr + 4)) {
+		u64 reg;
+		LOCK(addr);
+		reg = ga_reg_read64_locked(addr, mask, caller);
+		UNLOCK;
+		return reg;
+	}
+
+	/* A register crossing a page: the halves are read under their own lock */
+#ifdef __LITTLE_ENDIAN
+	lsv = (u64)ga_reg_read32_caller(addr, (u32)(mask & 0x00000000ffffffffULL), caller);
+	msv = (u64)ga_reg_read32_caller(addr + 4, (u32)(mask >> 32), caller);
+#else
+	msv = (u64)ga_reg_read32_caller(addr, (u32)(mask >> 32), caller);
+	lsv = (u64)ga_reg_read32_caller(addr + 4, (u32)(mask & 0x00000000ffffffffULL), caller);
+#endif
+	return (msv << 32) | lsv;
+}
+
+u64 ga_reg_read64(void __iomem *addr, u64 mask)
+{
+	return ga_reg_read64_caller(addr, mask, _RET_IP_);
+}
+EXPORT_SYMBOL_GPL(ga_reg_read64);
+
+/* Both halves are read within one seqcount section (the registers of an
+ * aligned 64-bit register share a page, and so their lock).
+ */
+u64 ga_reg_read64_lockless(void __iomem *addr, u64 mask)
+{
+	struct ga_lock	*lock = ga_lock_get(addr);
+	unsigned int	seq;
+	u64		lsv, msv;
+
+	if ((ga_lock_mode != GA_LM_SPINLOCK) || (lock != ga_lock_get(addr + 4)) || ga_reg_hooked(addr))
+		return ga_reg_read64_caller(addr, mask, _RET_IP_);
+
+	ga_stat_inc(GA_STAT_READ32);
+	ga_stat_inc(GA_STAT_READ32);
+	ga_stat_inc(GA_STAT_LOCKLESS);
+	for (;;) {
+		seq = read_seqcount_begin(&lock->seq);
+#ifdef __LITTLE_ENDIAN
+		lsv = (u64)ga_raw_readl(addr);
+		msv = (u64)ga_raw_readl(addr + 4);
+#else
+		msv = (u64)ga_raw_readl(addr);
+		lsv = (u64)ga_raw_readl(addr + 4);
+#endif
+		if (!read_seqcount_retry(&lock->seq, seq))
+			break;
+		ga_stat_inc(GA_STAT_LOCKLESS_RETRY);
+	}
+	ga_trace(GA_TRACE_READ, GA_TRACE_F_LOCKLESS, addr, u64, mask, (msv << 32) | lsv, 0, _RET_IP_);
+	return ((msv << 32) | lsv) & mask;
+}
+EXPORT_SYMBOL_GPL(ga_reg_read64_lockless);
+#endif
+
+/******************************************************************************/
+/* Free-running counters are updated by the hardware, not under the lock. On
+ * 32-bit kernels the high half is read before and after the low half, and the
+ * low half read again while a carry into the high half happened in between.
+ */
+u64 ga_reg_read64_counter(void __iomem *addr, u64 mask)
+{
+#ifdef CONFIG_64BIT
+	u64 reg;
+
+	ga_stat_inc(GA_STAT_READ64);
+	ga_stat_inc(GA_STAT_LOCKLESS);
+	reg = ga_raw_readq(addr);
+	ga_trace(GA_TRACE_READ, GA_TRACE_F_LOCKLESS, addr, u64, mask, reg, 0, _RET_IP_);
+	return reg & mask;
+#else
+#ifdef __LITTLE_ENDIAN
+	void __iomem	*lo = addr, *hi = addr + 4;
+#else
+	void __iomem	*lo = addr + 4, *hi = addr;
+#endif
+	u32		h1, h2, l;
+
+	ga_stat_inc(GA_STAT_READ32);
+	ga_stat_inc(GA_STAT_READ32);
+	ga_stat_inc(GA_STAT_LOCKLESS);
+	h1 = ga_raw_readl(hi);
+	for (;;) {
+		l = ga_raw_readl(lo);
+		h2 = ga_raw_readl(hi);
+		if (h1 == h2)
+			break;
+		ga_stat_inc(GA_STAT_LOCKLESS_RETRY);
+		h1 = h2;
+	}
+	ga_trace(GA_TRACE_READ, GA_TRACE_F_LOCKLESS, addr, u64, mask, ((u64)h1 << 32) | l, 0, _RET_IP_);
+	return (((u64)h1 << 32) | l) & mask;
+#endif
+}
+EXPORT_SYMBOL_GPL(ga_reg_read64_counter);
+
+/******************************************************************************/
+int ga_reg_read(void __iomem *addr, int access_size, u64 mask, u64 *value)
+{
+	/* Handle read operation */
+	switch (access_size) {
+	case 8:
+		*value = (u64)ga_reg_read8_caller(addr, (u8)mask, _RET_IP_);
+		break;
+	case 16:
+		*value = (u64)ga_reg_read16_caller(addr, (u16)mask, _RET_IP_);
+		break;
+	case 32:
+		*value = (u64)ga_reg_read32_caller(addr, (u32)mask, _RET_IP_);
+		break;
+	case 64:
+		*value = (u64)ga_reg_read64_caller(addr, (u64)mask, _RET_IP_);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_reg_read);
+
+/******************************************************************************
+ * Polling
+ ******************************************************************************/
+/* Spin while the call site usually completes within twice the elapsed time
+ * (GA_POLL_SPIN_MIN_NS..GA_POLL_SPIN_MAX_NS), then sleep. Sleeps are a quarter
+ * of the elapsed time (so they grow), shortened to wake up at the expected
+ * completion. Sleeps from GA_POLL_HRTIMER_NS on use a hrtimer with more slack.
+ */
+#define GA_POLL_SPIN_MIN_NS	1000
+#define GA_POLL_SPIN_MAX_NS	20000
+#define GA_POLL_SLEEP_MIN_NS	10000
+#define GA_POLL_HRTIMER_NS	2000000
+
+/* Sites register on their first call, which may be atomic (IRQ or spinlock
+ * held), so the list is protected by an irq safe spinlock.
+ */
+static LIST_HEAD(ga_poll_sites);
+static DEFINE_SPINLOCK(ga_poll_lock);
+
+static void ga_poll_site_register(struct ga_poll_site *site)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&ga_poll_lock, flags);
+	if (!site->registered) {
+		list_add_tail(&site->list, &ga_poll_sites);
+		site->registered = true;
+	}
+	spin_unlock_irqrestore(&ga_poll_lock, flags);
+}
+
+/******************************************************************************/
+static int ga_reg_read_lockless(void __iomem *addr, int access_size, u64 mask, u64 *value)
+{
+	switch (access_size) {
+	case 8:
+		*value = (u64)ga_reg_read8_lockless(addr, (u8)mask);
+		break;
+	case 16:
+		*value = (u64)ga_reg_read16_lockless(addr, (u16)mask);
+		break;
+	case 32:
+		*value = (u64)ga_reg_read32_lockless(addr, (u32)mask);
+		break;
+	case 64:
+		*value = ga_reg_read64_lockless(addr, mask);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/******************************************************************************/
+static void ga_poll_sleep(u64 ns)
+{
+	if (ns < GA_POLL_HRTIMER_NS) {
+		unsigned long us = div_u64(ns, NSEC_PER_USEC);
+		usleep_range(us, us + us / 4 + 1);
+	} else {
+		ktime_t t = ns_to_ktime(ns);
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout_range(&t, ns / 8, HRTIMER_MODE_REL);
+	}
+}
+
+/******************************************************************************/
+int ga_reg_poll(struct ga_poll_site *site, void __iomem *addr, int access_size, u64 mask, u64 value,
+	unsigned long timeout_us, bool atomic)
+{
+	u64		avg = READ_ONCE(site->avg_ns);
+	u64		spin_ns = GA_POLL_SPIN_MIN_NS;
+	u64		start, now, deadline, elapsed;
+	u64		val;
+	int		ret;
+
+	if (!atomic)
+		might_sleep();
+	/* The reads would take the mutex */
+	else if (WARN_ON_ONCE(READ_ONCE(ga_lock_mode) == GA_LM_MUTEX))
+		return -EOPNOTSUPP;
+	if (!READ_ONCE(site->registered))
+		ga_poll_site_register(site);
+
+	if ((avg * 2 > spin_ns) && (avg * 2 <= GA_POLL_SPIN_MAX_NS))
+		spin_ns = avg * 2;
+
+	start = ktime_get_ns();
+	deadline = start + (u64)timeout_us * NSEC_PER_USEC;
+	for (;;) {
+		ret = ga_reg_read_lockless(addr, access_size, mask, &val);
+		if (ret < 0)
+			return ret;
+		now = ktime_get_ns();
+		if (val == (value & mask))
+			break;
+		if (now >= deadline) {
+			atomic_inc(&site->timeouts);
+			return -ETIMEDOUT;
+		}
+
+		elapsed = now - start;
+		if (atomic || (elapsed < spin_ns)) {
+			cpu_relax();
+		} else {
+			u64 sleep_ns = max_t(u64, elapsed / 4, GA_POLL_SLEEP_MIN_NS);
+			if ((start + avg > now) && (start + avg - now >= GA_POLL_SLEEP_MIN_NS))
+				sleep_ns = min(sleep_ns, start + avg - now);
+			ga_poll_sleep(min(sleep_ns, deadline - now));
+		}
+	}
+
+	/* Completed: update the average (1/8 weight) and the histogram */
+	elapsed = now - start;
+	WRITE_ONCE(site->avg_ns, avg ? avg - avg / 8 + elapsed / 8 : elapsed);
+	atomic_inc(&site->count);
+	atomic_inc(&site->hist[min_t(unsigned int, fls64(elapsed), GA_POLL_HIST_BUCKETS - 1)]);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_reg_poll);
+
+/******************************************************************************/
+/* The call sites of a module which is unloaded go away with it */
+static int ga_poll_module_notify(struct notifier_block *nb, unsigned long action, void *data)
+{
+	struct module		*mod = data;
+	struct ga_poll_site	*site, *tmp;
+	unsigned long		flags;
+
+	if (action != MODULE_STATE_GOING)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&ga_poll_lock, flags);
+	list_for_each_entry_safe(site, tmp, &ga_poll_sites, list) {
+		if (within_module((unsigned long)site, mod)) {
+			list_del(&site->list);
+			site->registered = false;
+		}
+	}
+	spin_unlock_irqrestore(&ga_poll_lock, flags);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block ga_poll_module_nb = {
+	.notifier_call = ga_poll_module_notify,
+};
+
+/******************************************************************************
+ * Copying
+ ******************************************************************************/
+/* Bulk copies take the lock once per chunk. A chunk never crosses a page (so
+ * needs one lock only) and is bounded, which bounds the time the lock is held.
+ */
+#define GA_COPY_CHUNK	256
+
+/* Widest access which is aligned for 'addr' and fits in 'count' */
+static __always_inline int ga_copy_width(unsigned long addr, size_t count)
+{
+#ifdef CONFIG_64BIT
+	if (!(addr & 7) && (count >= 8))
+		return 8;
+#endif
+	if (!(addr & 3) && (count >= 4))
+		return 4;
+	if (!(addr & 1) && (count >= 2))
+		return 2;
+	return 1;
+}
+
+/******************************************************************************/
+static void ga_copy_toio_locked(void __iomem *dst, const u8 *src, size_t count)
+{
+	while (count) {
+		int n = ga_copy_width((unsigned long)dst, count);
+
+		switch (n) {
+#ifdef CONFIG_64BIT
+		case 8: {
+			u64 v = get_unaligned((const u64 *)src);
+			ga_raw_writeq(v, dst);
+			ga_cache_put(dst, &v);
+			break;
+		}
+#endif
+		case 4: {
+			u32 v = get_unaligned((const u32 *)src);
+			ga_raw_writel(v, dst);
+			ga_cache_put(dst, &v);
+			break;
+		}
+		case 2: {
+			u16 v = get_unaligned((const u16 *)src);
+			ga_raw_writew(v, dst);
+			ga_cache_put(dst, &v);
+			break;
+		}
+		default: {
+			u8 v = *src;
+			ga_raw_writeb(v, dst);
+			ga_cache_put(dst, &v);
+			break;
+		}
+		}
+		dst += n;
+		src += n;
+		count -= n;
+	}
+}
+
+static void ga_copy_fromio_locked(u8 *dst, const void __iomem *src, size_t count)
+{
+	while (count) {
+		int n = ga_copy_width((unsigned long)src, count);
+
+		switch (n) {
+#ifdef CONFIG_64BIT
+		case 8: {
+			u64 v = ga_raw_readq(src);
+			put_unaligned(v, (u64 *)dst);
+			ga_cache_put(src, &v);
+			break;
+		}
+#endif
+		case 4: {
+			u32 v = ga_raw_readl(src);
+			put_unaligned(v, (u32 *)dst);
+			ga_cache_put(src, &v);
+			break;
+		}
+		case 2: {
+			u16 v = ga_raw_readw(src);
+			put_unaligned(v, (u16 *)dst);
+			ga_cache_put(src, &v);
+			break;
+		}
+		default: {
+			u8 v = ga_raw_readb(src);
+			*dst = v;
+			ga_cache_put(src, &v);
+			break;
+		}
+		}
+		dst += n;
+		src += n;
+		count -= n;
+	}
+}
+
+/******************************************************************************/
+static inline size_t ga_copy_chunk(const volatile void __iomem *addr, size_t count)
+{
+	return min3(count, (size_t)GA_COPY_CHUNK, (size_t)(PAGE_SIZE - offset_in_page(addr)));
+}
+
+/******************************************************************************/
+int ga_memcpy_toio(void __iomem *dst, const void *src, size_t count)
+{
+	const u8	*from = src;
+	u64		start = ga_stats_clock();
+	size_t		total = count;
+
+	while (count) {
+		size_t chunk = ga_copy_chunk(dst, count);
+		LOCK(dst);
+		ga_write_begin(lock);
+		ga_copy_toio_locked(dst, from, chunk);
+		ga_write_end(lock);
+		UNLOCK;
+		dst += chunk;
+		from += chunk;
+		count -= chunk;
+	}
+
+	if (start != 0) {
+		ga_stat_add(GA_STAT_COPY_TO_BYTES, total);
+		ga_stat_add(GA_STAT_COPY_TO_NS, local_clock() - start);
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_memcpy_toio);
+
+/******************************************************************************/
+int ga_memcpy_fromio(void *dst, const void __iomem *src, size_t count)
+{
+	u8		*to = dst;
+	u64		start = ga_stats_clock();
+	size_t		total = count;
+
+	while (count) {
+		size_t chunk = ga_copy_chunk(src, count);
+		LOCK(src);
+		ga_copy_fromio_locked(to, src, chunk);
+		UNLOCK;
+		to += chunk;
+		src += chunk;
+		count -= chunk;
+	}
+
+	if (start != 0) {
+		ga_stat_add(GA_STAT_COPY_FROM_BYTES, total);
+		ga_stat_add(GA_STAT_COPY_FROM_NS, local_clock() - start);
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_memcpy_fromio);
+
+/******************************************************************************
+ * Batching
+ ******************************************************************************/
+/* Take the locks in 'locks' in ascending order, so concurrent users of several
+ * locks cannot deadlock. The caller is considered a writer of all of them.
+ */
+static u64 ga_locks_acquire(const unsigned long *locks, unsigned long *flags)
+{
+	u64 lock_time = ga_stats_clock();
+	int i;
+
+	if (ga_lock_mode == GA_LM_SPINLOCK) {
+		local_irq_save(*flags);
+		for_each_set_bit(i, locks, GA_LOCK_COUNT) {
+			spin_lock(&ga_locks[i].spinlock);
+			write_seqcount_begin(&ga_locks[i].seq);
+		}
+	} else {
+		for_each_set_bit(i, locks, GA_LOCK_COUNT)
+			mutex_lock(&ga_locks[i].mutex);
+	}
+	return ga_stats_lock_taken(lock_time);
+}
+
+static void ga_locks_release(const unsigned long *locks, unsigned long flags, u64 lock_time)
+{
+	int i;
+
+	ga_stats_lock_release(lock_time);
+	if (ga_lock_mode == GA_LM_SPINLOCK) {
+		for_each_set_bit(i, locks, GA_LOCK_COUNT) {
+			write_seqcount_end(&ga_locks[i].seq);
+			spin_unlock(&ga_locks[i].spinlock);
+		}
+		local_irq_restore(flags);
+	} else {
+		for_each_set_bit(i, locks, GA_LOCK_COUNT)
+			mutex_unlock(&ga_locks[i].mutex);
+	}
+}
+
+/******************************************************************************/
+static int ga_reg_op_check(const struct ga_reg_op *op)
+{
+	switch (op->size) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if ((op->op != GA_READ) && !(op->op & (GA_WRITE|GA_READ_WRITE_CONDITIONAL|GA_READ_WRITE_ALWAYS)))
+		return -EINVAL;
+
+	return 0;
+}
+
+/******************************************************************************/
+static void ga_reg_op_locked(struct ga_reg_op *op, unsigned long caller)
+{
+	op->result = 0;
+	op->modified = GA_MODIFIED_NONE;
+
+	/* Handle read operation */
+	if (op->op == GA_READ) {
+		switch (op->size) {
+		case 8:
+			op->result = (u64)ga_reg_read8_locked(op->addr, (u8)op->mask, caller);
+			break;
+		case 16:
+			op->result = (u64)ga_reg_read16_locked(op->addr, (u16)op->mask, caller);
+			break;
+		case 32:
+			op->result = (u64)ga_reg_read32_locked(op->addr, (u32)op->mask, caller);
+			break;
+		case 64:
+			op->result = (u64)ga_reg_read64_locked(op->addr, (u64)op->mask, caller);
+			break;
+		}
+		return;
+	}
+
+	/* Handle write operation */
+	switch (op->size) {
+	case 8:
+		op->modified = ga_reg_write8_locked(op->addr, (u8)op->mask, (u8)op->value, op->op, caller);
+		break;
+	case 16:
+		op->modified = ga_reg_write16_locked(op->addr, (u16)op->mask, (u16)op->value, op->op, caller);
+		break;
+	case 32:
+		op->modified = ga_reg_write32_locked(op->addr, (u32)op->mask, (u32)op->value, op->op, caller);
+		break;
+	case 64:
+		op->modified = ga_reg_write64_locked(op->addr, (u64)op->mask, (u64)op->value, op->op, caller);
+		break;
+	}
+}
+
+/******************************************************************************/
+int ga_reg_batch(struct ga_reg_op *ops, int count)
+{
+	DECLARE_BITMAP(locks, GA_LOCK_COUNT);
+	unsigned long flags = 0;
+	u64 lock_time;
+	int i;
+
+	/* Validate all operations and collect the locks they need */
+	bitmap_zero(locks, GA_LOCK_COUNT);
+	for (i = 0; i < count; i++) {
+		if (ga_reg_op_check(&ops[i]) < 0)
+			return -EINVAL;
+		__set_bit(ga_lock_index(ops[i].addr), locks);
+#ifndef CONFIG_64BIT
+		if (ops[i].size == 64)
+			__set_bit(ga_lock_index(ops[i].addr + 4), locks);
+#endif
+	}
+
+	/* Usually all registers are on the same page and only one lock is taken */
+	lock_time = ga_locks_acquire(locks, &flags);
+	for (i = 0; i < count; i++)
+		ga_reg_op_locked(&ops[i], _RET_IP_);
+	ga_locks_release(locks, flags, lock_time);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_reg_batch);
+
+/******************************************************************************
+ * Sampling
+ ******************************************************************************/
+/* The ring is written by the hrtimer and read by one reader at a time: 'head'
+ * and 'tail' count rows, a row is (2 + count) u64 (see generic_access.h).
+ */
+struct ga_sampler {
+	struct hrtimer		timer;
+	ktime_t			period;
+	struct ga_reg_op	*ops;
+	int			count;
+	DECLARE_BITMAP(locks, GA_LOCK_COUNT);
+	u64			*ring;
+	unsigned int		rows;		/* a power of 2 */
+	unsigned int		row_size;	/* u64 per row */
+	unsigned int		head;		/* written by the timer */
+	unsigned int		tail;		/* written by the reader */
+	struct mutex		read_mutex;	/* one reader at a time */
+	unsigned int		wakeup;		/* rows before the reader is woken */
+	u64			seq;
+	bool			stopped;
+	wait_queue_head_t	wait;
+};
+
+/* Read all registers in one lock hold, drop the sample when the ring is full */
+static enum hrtimer_restart ga_sampler_fn(struct hrtimer *timer)
+{
+	struct ga_sampler	*s = container_of(timer, struct ga_sampler, timer);
+	unsigned int		head = s->head;
+	unsigned long		flags = 0;
+	u64			lock_time;
+	u64			*row;
+	int			i;
+
+	hrtimer_forward_now(timer, s->period);
+
+	if (head - smp_load_acquire(&s->tail) >= s->rows) {
+		s->seq++;
+		return HRTIMER_RESTART;
+	}
+
+	row = s->ring + (head & (s->rows - 1)) * s->row_size;
+	lock_time = ga_locks_acquire(s->locks, &flags);
+	row[0] = ktime_get_ns();
+	for (i = 0; i < s->count; i++) {
+		ga_reg_op_locked(&s->ops[i], _THIS_IP_);
+		row[2 + i] = s->ops[i].result;
+	}
+	ga_locks_release(s->locks, flags, lock_time);
+	row[1] = s->seq++;
+
+	smp_store_release(&s->head, head + 1);
+	if (head + 1 - READ_ONCE(s->tail) >= s->wakeup)
+		wake_up_interruptible(&s->wait);
+	return HRTIMER_RESTART;
+}
+
+/******************************************************************************/
+int ga_sampler_start(const struct ga_reg_op *ops, int count, u64 period_ns, unsigned int rows,
+	struct ga_sampler **sampler)
+{
+	struct ga_sampler	*s;
+	int			i;
+
+	/* The registers are read from the hrtimer interrupt */
+	if (ga_lock_mode != GA_LM_SPINLOCK)
+		return -EOPNOTSUPP;
+	if ((count <= 0) || (count > GA_SAMPLER_MAX_OPS) || (period_ns < GA_SAMPLER_MIN_PERIOD_NS) ||
+	    (rows == 0) || (rows > GA_SAMPLER_MAX_ROWS))
+		return -EINVAL;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (s == NULL)
+		return -ENOMEM;
+	s->count = count;
+	s->rows = roundup_pow_of_two(rows);
+	s->row_size = 2 + count;
+	s->wakeup = max(s->rows / 4, 1U);
+	s->period = ns_to_ktime(period_ns);
+	init_waitqueue_head(&s->wait);
+	mutex_init(&s->read_mutex);
+
+	s->ops = kmemdup(ops, count * sizeof(*ops), GFP_KERNEL);
+	s->ring = kvmalloc_array(s->rows, s->row_size * sizeof(u64), GFP_KERNEL);
+	if ((s->ops == NULL) || (s->ring == NULL)) {
+		ga_sampler_free(s);
+		return -ENOMEM;
+	}
+
+	bitmap_zero(s->locks, GA_LOCK_COUNT);
+	for (i = 0; i < count; i++) {
+		if ((ga_reg_op_check(&ops[i]) < 0) || (ops[i].op != GA_READ)) {
+			ga_sampler_free(s);
+			return -EINVAL;
+		}
+		__set_bit(ga_lock_index(ops[i].addr), s->locks);
+#ifndef CONFIG_64BIT
+		if (ops[i].size == 64)
+			__set_bit(ga_lock_index(ops[i].addr + 4), s->locks);
+#endif
+	}
+
+	hrtimer_init(&s->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	s->timer.function = ga_sampler_fn;
+	hrtimer_start(&s->timer, s->period, HRTIMER_MODE_REL);
+
+	*sampler = s;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ga_sampler_start);
+
+/******************************************************************************/
+void ga_sampler_stop(struct ga_sampler *s)
+{
+	hrtimer_cancel(&s->timer);
+	WRITE_ONCE(s->stopped, true);
+	wake_up_interruptible(&s->wait);
+}
+EXPORT_SYMBOL_GPL(ga_sampler_stop);
+
+/* Also called for a sampler which was never started */
+void ga_sampler_free(struct ga_sampler *s)
+{
+	kvfree(s->ring);
+	kfree(s->ops);
+	kfree(s);
+}
+EXPORT_SYMBOL_GPL(ga_sampler_free);
+
+/******************************************************************************/
+/* Concurrent readers would copy the same rows and move tail backwards, which
+ * lets the timer overwrite unread rows: read_mutex serializes them
+ */
+ssize_t ga_sampler_read(struct ga_sampler *s, char __user *buf, size_t count, bool nonblock)
+{
+	size_t		row_bytes = s->row_size * sizeof(u64);
+	unsigned int	tail;
+	unsigned int	head, n, first;
+	ssize_t		ret;
+
+	if (count < row_bytes)
+		return -EINVAL;
+
+	if (nonblock) {
+		if (!mutex_trylock(&s->read_mutex))
+			return -EAGAIN;
+	}
+	else {
+		ret = mutex_lock_interruptible(&s->read_mutex);
+		if (ret)
+			return ret;
+	}
+	tail = s->tail;
+
+	/* Wait for a batch of rows (or for the stop), so reads are in bulk */
+	if (!nonblock) {
+		ret = wait_event_interruptible(s->wait,
+			(smp_load_acquire(&s->head) - tail >= s->wakeup) || READ_ONCE(s->stopped));
+		if (ret)
+			goto out;
+	}
+
+	head = smp_load_acquire(&s->head);
+	n = min_t(size_t, head - tail, count / row_bytes);
+	if (n == 0) {
+		ret = READ_ONCE(s->stopped) ? 0 : -EAGAIN;
+		goto out;
+	}
+
+	/* Up to the end of the ring, then from its start */
+	ret = -EFAULT;
+	first = min(n, s->rows - (tail & (s->rows - 1)));
+	if (copy_to_user(buf, s->ring + (tail & (s->rows - 1)) * s->row_size, first * row_bytes))
+		goto out;
+	if ((n > first) && copy_to_user(buf + first * row_bytes, s->ring, (n - first) * row_bytes))
+		goto out;
+
+	smp_store_release(&s->tail, tail + n);
+	ret = n * row_bytes;
+out:
+	mutex_unlock(&s->read_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_sampler_read);
+
+/******************************************************************************
+ * Caching
+ ******************************************************************************/
+int ga_cache_init(void __iomem *ioaddr, phys_addr_t size)
+{
+	struct ga_ioaddr_ops	ops = { };
+	struct ga_region	*region;
+	int			ret;
+
+	mutex_lock(&ga_regions_mutex);
+	if (ga_region_overlaps((unsigned long)ioaddr, size, NULL)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	ret = ga_region_create(ioaddr, 0, size, &ops, NULL, &region);
+	if (ret)
+		goto out;
+
+	/* Shadow values and state bytes in one allocation */
+	region->cache.shadow = kzalloc(2 * size, GFP_KERNEL);
+	if (region->cache.shadow == NULL) {
+		kfree(region);
+		ret = -ENOMEM;
+		goto out;
+	}
+	region->cache.state = region->cache.shadow + size;
+	ga_region_insert(region);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_cache_init);
+
+/******************************************************************************/
+int ga_cache_exit(void __iomem *ioaddr)
+{
+	return ga_remove_ioaddr_ops(ioaddr);
+}
+EXPORT_SYMBOL_GPL(ga_cache_exit);
+
+/******************************************************************************/
+/* Must be called with ga_regions_mutex held */
+static struct ga_region *ga_cache_find(const void __iomem *ioaddr, phys_addr_t size)
+{
+	struct ga_region *region;
+
+	list_for_each_entry(region, &ga_region_list, list) {
+		if ((unsigned long)ioaddr < region->start)
+			continue;
+		if ((unsigned long)ioaddr + size > region->start + region->size)
+			continue;
+		return (region->cache.shadow != NULL) ? region : NULL;
+	}
+	return NULL;
+}
+
+/* Collect the locks of all registers in [start, start + size) */
+static void ga_locks_of_range(unsigned long *locks, unsigned long start, unsigned long size)
+{
+	unsigned long addr;
+
+	bitmap_zero(locks, GA_LOCK_COUNT);
+	for (addr = start & PAGE_MASK; addr < start + size; addr += PAGE_SIZE)
+		__set_bit(ga_lock_index((void __iomem *)addr), locks);
+}
+
+/******************************************************************************/
+int ga_cache_set_policy(void __iomem *ioaddr, phys_addr_t size, int policy)
+{
+	DECLARE_BITMAP(locks, GA_LOCK_COUNT);
+	struct ga_region	*region;
+	unsigned long		flags = 0;
+	unsigned long		off;
+	u64			lock_time;
+	int			ret = 0;
+
+	if ((policy & ~GA_CACHE_POLICY_MASK) || (policy > GA_CACHE_READ_WRITE))
+		return -EINVAL;
+
+	mutex_lock(&ga_regions_mutex);
+	region = ga_cache_find(ioaddr, size);
+	if (region == NULL) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	/* Changing the policy forgets the cached values */
+	ga_locks_of_range(locks, (unsigned long)ioaddr, size);
+	lock_time = ga_locks_acquire(locks, &flags);
+	off = (unsigned long)ioaddr - region->start;
+	memset(region->cache.state + off, policy, size);
+	ga_locks_release(locks, flags, lock_time);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_cache_set_policy);
+
+/******************************************************************************/
+/* Write back one cached register, the caller holds its lock */
+static void ga_cache_write_back(void __iomem *ioaddr, const u8 *shadow, int bytes)
+{
+	switch (bytes) {
+	case 1:
+		ga_raw_writeb(*shadow, ioaddr);
+		break;
+	case 2:
+		ga_raw_writew(*(const u16 *)shadow, ioaddr);
+		break;
+	case 4:
+		ga_raw_writel(*(const u32 *)shadow, ioaddr);
+		break;
+#ifdef CONFIG_64BIT
+	case 8:
+		ga_raw_writeq(*(const u64 *)shadow, ioaddr);
+		break;
+#endif
+	}
+}
+
+/******************************************************************************/
+int ga_cache_sync(void __iomem *ioaddr)
+{
+	DECLARE_BITMAP(locks, GA_LOCK_COUNT);
+	struct ga_region	*region;
+	unsigned long		flags = 0;
+	unsigned long		off;
+	u64			lock_time;
+	int			ret = 0;
+
+	mutex_lock(&ga_regions_mutex);
+	region = ga_cache_find(ioaddr, 1);
+	if ((region == NULL) || (region->start != (unsigned long)ioaddr)) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	ga_locks_of_range(locks, region->start, region->size);
+	lock_time = ga_locks_acquire(locks, &flags);
+	for (off = 0; off < region->size; ) {
+		u8	state = region->cache.state[off];
+		int	bytes = 1 << (state >> GA_CACHE_WIDTH_SHIFT);
+
+		if (((state & (GA_CACHE_VALID|GA_CACHE_START)) != (GA_CACHE_VALID|GA_CACHE_START)) ||
+		    (off + bytes > region->size)) {
+			off++;
+			continue;
+		}
+		ga_cache_write_back(ioaddr + off, region->cache.shadow + off, bytes);
+		off += bytes;
+	}
+	ga_locks_release(locks, flags, lock_time);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_cache_sync);
+
+/******************************************************************************/
+int ga_cache_invalidate(void __iomem *ioaddr)
+{
+	DECLARE_BITMAP(locks, GA_LOCK_COUNT);
+	struct ga_region	*region;
+	unsigned long		flags = 0;
+	unsigned long		off;
+	u64			lock_time;
+	int			ret = 0;
+
+	mutex_lock(&ga_regions_mutex);
+	region = ga_cache_find(ioaddr, 1);
+	if ((region == NULL) || (region->start != (unsigned long)ioaddr)) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	ga_locks_of_range(locks, region->start, region->size);
+	lock_time = ga_locks_acquire(locks, &flags);
+	for (off = 0; off < region->size; off++)
+		region->cache.state[off] &= GA_CACHE_POLICY_MASK;
+	ga_locks_release(locks, flags, lock_time);
+out:
+	mutex_unlock(&ga_regions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ga_cache_invalidate);
+
+/******************************************************************************
+ * Statistics
+ ******************************************************************************/
+static struct dentry *ga_debugfs_dir;
+
+static void ga_stats_show_hist(struct seq_file *m, const char *name, const u64 *hist)
+{
+	int i;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < GA_HIST_BUCKETS; i++) {
+		if (hist[i] == 0)
+			continue;
+		if (i == GA_HIST_BUCKETS - 1)
+			seq_printf(m, "  >= %llu ns: %llu\n", 1ULL << (i - 1), hist[i]);
+		else
+			seq_printf(m, "  < %llu ns: %llu\n", 1ULL << i, hist[i]);
+	}
+}
+
+static int ga_stats_show(struct seq_file *m, void *v)
+{
+	struct ga_stats		*sum; /* too big for the stack, one per reader */
+	int			cpu, i;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (sum == NULL)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		const struct ga_stats *st = per_cpu_ptr(&ga_stats, cpu);
+		for (i = 0; i < GA_STAT_COUNT; i++)
+			sum->count[i] += st->count[i];
+		for (i = 0; i < GA_HIST_BUCKETS; i++) {
+			sum->lock_wait[i] += st->lock_wait[i];
+			sum->lock_hold[i] += st->lock_hold[i];
+		}
+	}
+
+	seq_printf(m, "enabled: %d\n", static_key_enabled(&ga_stats_active) ? 1 : 0);
+	for (i = 0; i < GA_STAT_COUNT; i++)
+		seq_printf(m, "%s: %llu\n", ga_stat_names[i], sum->count[i]);
+	seq_printf(m, "copy_to_MBps: %llu\n",
+		div64_u64(sum->count[GA_STAT_COPY_TO_BYTES] * 1000, max_t(u64, sum->count[GA_STAT_COPY_TO_NS], 1)));
+	seq_printf(m, "copy_from_MBps: %llu\n",
+		div64_u64(sum->count[GA_STAT_COPY_FROM_BYTES] * 1000, max_t(u64, sum->count[GA_STAT_COPY_FROM_NS], 1)));
+	ga_stats_show_hist(m, "lock_wait", sum->lock_wait);
+	ga_stats_show_hist(m, "lock_hold", sum->lock_hold);
+	kfree(sum);
+	return 0;
+}
+
+static int ga_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ga_stats_show, NULL);
+}
+
+/* Writing anything resets the statistics */
+static ssize_t ga_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&ga_stats, cpu), 0, sizeof(struct ga_stats));
+	return count;
+}
+
+static const struct file_operations ga_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ga_stats_open,
+	.read		= seq_read,
+	.write		= ga_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/******************************************************************************/
+static int ga_polls_show(struct seq_file *m, void *v)
+{
+	struct ga_poll_site	*site;
+	unsigned long		flags;
+	int			i;
+
+	/* seq_printf only fills the seq buffer, it does not sleep */
+	spin_lock_irqsave(&ga_poll_lock, flags);
+	list_for_each_entry(site, &ga_poll_sites, list) {
+		seq_printf(m, "%s:%d: count %d, timeouts %d, average %llu ns\n", site->func, site->line,
+			atomic_read(&site->count), atomic_read(&site->timeouts), READ_ONCE(site->avg_ns));
+		for (i = 0; i < GA_POLL_HIST_BUCKETS; i++) {
+			int n = atomic_read(&site->hist[i]);
+			if (n == 0)
+				continue;
+			if (i == GA_POLL_HIST_BUCKETS - 1)
+				seq_printf(m, "  >= %llu ns: %d\n", 1ULL << (i - 1), n);
+			else
+				seq_printf(m, "  < %llu ns: %d\n", 1ULL << i, n);
+		}
+	}
+	spin_unlock_irqrestore(&ga_poll_lock, flags);
+	return 0;
+}
+
+static int ga_polls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ga_polls_show, NULL);
+}
+
+static const struct file_operations ga_polls_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ga_polls_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/******************************************************************************/
+static int ga_stats_enable_get(void *data, u64 *val)
+{
+	*val = static_key_enabled(&ga_stats_active) ? 1 : 0;
+	return 0;
+}
+
+static int ga_stats_enable_set(void *data, u64 val)
+{
+	if (val)
+		static_branch_enable(&ga_stats_active);
+	else
+		static_branch_disable(&ga_stats_active);
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(ga_stats_enable_fops, ga_stats_enable_get, ga_stats_enable_set, "%llu\n");
+
+/******************************************************************************/
+/* debugfs "trace" is created unsafe, the full proxy of debugfs_create_file does
+ * not forward mmap: read and mmap hold the file against its removal
+ * themselves. The buffer is only freed once the file is removed, and a mapping
+ * keeps the file, hence the module, referenced.
+ */
+static ssize_t ga_trace_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	ssize_t rc;
+
+	rc = debugfs_file_get(file->f_path.dentry);
+	if (rc)
+		return rc;
+	rc = -ENODEV;
+	mutex_lock(&ga_trace_mutex);
+	if (ga_trace_buf != NULL)
+		rc = simple_read_from_buffer(buf, count, ppos, ga_trace_buf, ga_trace_size);
+	mutex_unlock(&ga_trace_mutex);
+	debugfs_file_put(file->f_path.dentry);
+	return rc;
+}
+
+static int ga_trace_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int rc;
+
+	rc = debugfs_file_get(file->f_path.dentry);
+	if (rc)
+		return rc;
+	rc = -ENODEV;
+	mutex_lock(&ga_trace_mutex);
+	if (ga_trace_buf != NULL)
+		rc = remap_vmalloc_range(vma, ga_trace_buf, vma->vm_pgoff);
+	mutex_unlock(&ga_trace_mutex);
+	debugfs_file_put(file->f_path.dentry);
+	return rc;
+}
+
+static const struct file_operations ga_trace_fops = {
+	.owner		= THIS_MODULE,
+	.read		= ga_trace_read,
+	.mmap		= ga_trace_mmap,
+	.llseek		= default_llseek,
+};
+
+static int ga_trace_alloc(void)
+{
+	struct ga_trace_header	*header;
+	unsigned int		entries;
+
+	if (trace_entries <= 0)
+		return -EINVAL;
+	entries = roundup_pow_of_two(trace_entries);
+	ga_trace_ring_size = sizeof(struct ga_trace_ring) + entries * sizeof(struct ga_trace_entry);
+	ga_trace_size = sizeof(struct ga_trace_header) + nr_cpu_ids * ga_trace_ring_size;
+	ga_trace_buf = vmalloc_user(ga_trace_size); /* zeroed */
+	if (ga_trace_buf == NULL)
+		return -ENOMEM;
+	ga_trace_entries = entries;
+
+	header = ga_trace_buf;
+	header->magic = GA_TRACE_MAGIC;
+	header->version = GA_TRACE_VERSION;
+	header->cpus = nr_cpu_ids;
+	header->entries = entries;
+	header->entry_size = sizeof(struct ga_trace_entry);
+	header->ring_size = ga_trace_ring_size;
+	return 0;
+}
+
+static int ga_trace_enable_get(void *data, u64 *val)
+{
+	*val = static_key_enabled(&ga_trace_active) ? 1 : 0;
+	return 0;
+}
+
+/* Enabling restarts the trace from empty rings */
+static int ga_trace_enable_set(void *data, u64 val)
+{
+	int rc = 0;
+	int cpu;
+
+	mutex_lock(&ga_trace_mutex);
+	if (val == 0) {
+		static_branch_disable(&ga_trace_active);
+		/* Wait for the records in progress (interrupts are off) */
+		synchronize_rcu();
+	}
+	else if (!static_key_enabled(&ga_trace_active)) {
+		if (ga_trace_buf == NULL)
+			rc = ga_trace_alloc();
+		if (rc == 0) {
+			for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+				WRITE_ONCE(ga_trace_ring(cpu)->head, 0);
+				WRITE_ONCE(ga_trace_ring(cpu)->wraps, 0);
+			}
+			static_branch_enable(&ga_trace_active);
+		}
+	}
+	mutex_unlock(&ga_trace_mutex);
+	return rc;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(ga_trace_enable_fops, ga_trace_enable_get, ga_trace_enable_set, "%llu\n");
+
+/******************************************************************************
+ * Module initializations
+ ******************************************************************************/
+static int __init ga_init(void)
+{
+	int i;
+
+	for (i = 0; i < GA_LOCK_COUNT; i++) {
+		spin_lock_init(&ga_locks[i].spinlock);
+		mutex_init(&ga_locks[i].mutex);
+		seqcount_init(&ga_locks[i].seq);
+		lockdep_set_class(&ga_locks[i].spinlock, &ga_spinlock_keys[i]);
+		lockdep_set_class(&ga_locks[i].mutex, &ga_mutex_keys[i]);
+	}
+
+	if (stats)
+		static_branch_enable(&ga_stats_active);
+
+	/* Statistics are optional, debugfs errors are not fatal */
+	ga_debugfs_dir = debugfs_create_dir("generic_access", NULL);
+	debugfs_create_file("stats", 0600, ga_debugfs_dir, NULL, &ga_stats_fops);
+	debugfs_create_file_unsafe("enable", 0600, ga_debugfs_dir, NULL, &ga_stats_enable_fops);
+	debugfs_create_file("polls", 0400, ga_debugfs_dir, NULL, &ga_polls_fops);
+	debugfs_create_file_unsafe("trace", 0400, ga_debugfs_dir, NULL, &ga_trace_fops);
+	debugfs_create_file_unsafe("trace_enable", 0600, ga_debugfs_dir, NULL, &ga_trace_enable_fops);
+
+	return register_module_notifier(&ga_poll_module_nb);
+}
+
+/******************************************************************************/
+static void __exit ga_exit(void)
+{
+	struct ga_region *region, *tmp;
+	LIST_HEAD(removed);
+
+	unregister_module_notifier(&ga_poll_module_nb);
+	debugfs_remove_recursive(ga_debugfs_dir);
+
+	mutex_lock(&ga_regions_mutex);
+	list_for_each_entry_safe(region, tmp, &ga_region_list, list) {
+		ga_region_remove(region);
+		list_add(&region->list, &removed);
+	}
+	mutex_unlock(&ga_regions_mutex);
+	synchronize_srcu(&ga_regions_srcu);
+
+	list_for_each_entry_safe(region, tmp, &removed, list)
+		ga_region_free(region);
+
+	/* No access can be traced anymore, and debugfs "trace" is gone */
+	vfree(ga_trace_buf);
+}
+
+/******************************************************************************/
+module_init(ga_init);
+module_exit(ga_exit);
 
 /******************************************************************************/
 MODULE_AUTHOR("babytech@126.com");
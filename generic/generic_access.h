@@ -18,6 +18,8 @@
 #define KERNEL_GENERIC_ACCESS_H
 
 #include <linux/types.h>
+#include <linux/list.h>
+#include <linux/atomic.h>
 
 /* Options of ga_reg_writeX */
 #define GA_WRITE			0x01 /* Write operation: only write, do not read first */
@@ -53,19 +55,208 @@ u32 ga_reg_read32(void __iomem *addr, u32 mask);
 u64 ga_reg_read64(void __iomem *addr, u64 mask);
 int ga_reg_read(void __iomem *addr, int access_size, u64 mask, u64 *value);
 
+/* Same as ga_reg_readX, but without taking the lock (e.g. for polling status
+ * registers). The read is repeated when a write to a register sharing the lock
+ * was in flight, so only use it on registers whose read has no side effects.
+ * The shadow cache is not used. In GA_LM_MUTEX mode the lock is taken anyway,
+ * and so it is for the registers of a region (hooks, posted writes, cache) or
+ * under the physical address hooks: only plain MMIO is read without the lock.
+ */
+u8 ga_reg_read8_lockless(void __iomem *addr, u8 mask);
+u16 ga_reg_read16_lockless(void __iomem *addr, u16 mask);
+u32 ga_reg_read32_lockless(void __iomem *addr, u32 mask);
+u64 ga_reg_read64_lockless(void __iomem *addr, u64 mask);
+
+/* Read a 64-bit free-running counter (e.g. a timestamp) which the hardware
+ * updates itself. No lock is taken. On 32-bit kernels the high half is read
+ * before and after the low half (hi-lo-hi) and the read is repeated when they
+ * differ, so a carry between the halves cannot give a torn value; the lock of
+ * ga_reg_read64 only protects against writes through generic_access.
+ * It is meant for hardware counters: unlike ga_reg_readX_lockless, it calls
+ * the read hooks of a region without the lock as well.
+ */
+u64 ga_reg_read64_counter(void __iomem *addr, u64 mask);
+
+/* Wait until (register & mask) == value, or at most 'timeout_us'.
+ * Returns 0, -ETIMEDOUT or -EINVAL (access size). The register is read without
+ * lock (see ga_reg_readX_lockless), so its read must not have side effects.
+ * In GA_LM_MUTEX mode the reads take the mutex, so ga_reg_poll_timeout_atomic
+ * warns and returns -EOPNOTSUPP there.
+ *
+ * The wait first spins, then sleeps with usleep_range and, for longer waits,
+ * with a hrtimer. Every call site keeps the average completion time, which
+ * sets how long to spin and when to wake up, and a log2 histogram of the
+ * completion times (debugfs generic_access/polls).
+ * ga_reg_poll_timeout may sleep, ga_reg_poll_timeout_atomic only spins.
+ */
+#define GA_POLL_HIST_BUCKETS	32
+
+struct ga_poll_site {
+	const char		*func;
+	int			line;
+	bool			registered;
+	struct list_head	list;
+	u64			avg_ns;		/* average completion time */
+	atomic_t		count;
+	atomic_t		timeouts;
+	atomic_t		hist[GA_POLL_HIST_BUCKETS];
+};
+
+int ga_reg_poll(struct ga_poll_site *site, void __iomem *addr, int access_size, u64 mask, u64 value,
+	unsigned long timeout_us, bool atomic);
+
+#define __ga_reg_poll_timeout(__addr, __size, __mask, __value, __timeout_us, __atomic)	\
+({											\
+	static struct ga_poll_site __ga_poll_site = { .func = __func__, .line = __LINE__ }; \
+	ga_reg_poll(&__ga_poll_site, __addr, __size, __mask, __value, __timeout_us, __atomic); \
+})
+
+#define ga_reg_poll_timeout(__addr, __size, __mask, __value, __timeout_us)		\
+	__ga_reg_poll_timeout(__addr, __size, __mask, __value, __timeout_us, false)
+#define ga_reg_poll_timeout_atomic(__addr, __size, __mask, __value, __timeout_us)	\
+	__ga_reg_poll_timeout(__addr, __size, __mask, __value, __timeout_us, true)
+
+/* Copy 'count' bytes to or from registers (e.g. a memory mapped RAM), with the
+ * widest aligned accesses (64-bit on 64-bit kernels). Hooks and the shadow cache
+ * apply as for ga_reg_writeX/ga_reg_readX, but the lock is only taken once per
+ * chunk of up to 256 bytes.
+ */
+int ga_memcpy_toio(void __iomem *dst, const void *src, size_t count);
+int ga_memcpy_fromio(void *dst, const void __iomem *src, size_t count);
+
+/* Execute a sequence of register operations under one lock acquisition.
+ *
+ * 'op' is GA_READ or one of the ga_reg_writeX options above.
+ * For reads, 'result' is set to the (masked) register value. For writes,
+ * 'modified' is set to the GA_MODIFIED_XXX code ga_reg_writeX would return.
+ * The operations are executed in order. Nothing is executed when one of the
+ * operations is invalid (-EINVAL).
+ */
+#define GA_READ			0x00 /* Read operation (ga_reg_batch only) */
+
+struct ga_reg_op {
+	void __iomem	*addr;
+	int		size;		/* Access size: 8, 16, 32 or 64 */
+	int		op;		/* GA_READ, GA_WRITE or GA_READ_WRITE_XXX */
+	u64		mask;
+	u64		value;		/* Value to write */
+	u64		result;		/* Value read */
+	int		modified;	/* GA_MODIFIED_XXX of a write */
+};
+
+#define GA_REG_OP(__addr, __size, __op, __mask, __value)				\
+	{ .addr = (__addr), .size = (__size), .op = (__op), .mask = (__mask), .value = (__value) }
+
+int ga_reg_batch(struct ga_reg_op *ops, int count);
+
+/* Periodic sampling of registers, e.g. hardware counters at kHz rates.
+ * Every 'period_ns' a hrtimer reads the 'count' GA_READ operations of 'ops' in
+ * one lock hold (as ga_reg_batch) and appends a row to a ring of 'rows' rows
+ * (rounded up to a power of 2). A row is (2 + count) u64: the time of the
+ * sample (ktime_get_ns), its sequence number and the masked values in the order
+ * of 'ops'. When the ring is full, samples are dropped: the sequence numbers
+ * of the rows then have a gap.
+ * ga_sampler_read copies whole rows to userspace and returns the number of
+ * bytes. It first waits until a quarter of the ring is filled (unless
+ * 'nonblock'), and returns 0 once the sampler is stopped and the ring is empty.
+ * Concurrent reads are serialized (a non-blocking one returns -EAGAIN while
+ * another read is in progress). The registers are read in interrupt context, so
+ * sampling needs GA_LM_SPINLOCK mode (-EOPNOTSUPP) and registers whose read
+ * has no side effects. ga_sampler_stop stops the timer (readers return),
+ * ga_sampler_free frees the sampler once no reader uses it anymore.
+ */
+#define GA_SAMPLER_MAX_OPS		128
+#define GA_SAMPLER_MAX_ROWS		(1 << 20)
+#define GA_SAMPLER_MIN_PERIOD_NS	10000	/* 100 kHz */
+
+struct ga_sampler;
+
+int ga_sampler_start(const struct ga_reg_op *ops, int count, u64 period_ns, unsigned int rows,
+	struct ga_sampler **sampler);
+void ga_sampler_stop(struct ga_sampler *sampler);
+void ga_sampler_free(struct ga_sampler *sampler);
+ssize_t ga_sampler_read(struct ga_sampler *sampler, char __user *buf, size_t count, bool nonblock);
+
 /* Hooks for reading and writing to a memory location.
- * For the moment only 8-bit accesses can be hooked into.
+ * The hooks receive the physical address of the register which is accessed.
+ * Hooks which are not set (NULL) let the access go to the hardware.
+ * read64/write64 are only used on 64-bit kernels, elsewhere 64-bit accesses
+ * are split into two 32-bit accesses.
  */
 struct ga_ioaddr_ops {
 	int (*init)(phys_addr_t addr, phys_addr_t size, void *opaque);
 	u8 (*read8)(phys_addr_t addr, void *opaque);
+	u16 (*read16)(phys_addr_t addr, void *opaque);
+	u32 (*read32)(phys_addr_t addr, void *opaque);
+	u64 (*read64)(phys_addr_t addr, void *opaque);
 	void (*write8)(u8 val, phys_addr_t addr, void *opaque);
+	void (*write16)(u16 val, phys_addr_t addr, void *opaque);
+	void (*write32)(u32 val, phys_addr_t addr, void *opaque);
+	void (*write64)(u64 val, phys_addr_t addr, void *opaque);
 };
 
+/* Add hooks for the registers at [ioaddr, ioaddr + size), which are the
+ * ioremap'ed registers at physical address 'addr'. Any number of ranges can be
+ * hooked, but they may not overlap (-EBUSY). Ranges can be added and removed
+ * while registers are being accessed; ga_remove_ioaddr_ops (by 'ioaddr' as
+ * passed to ga_add_ioaddr_ops) returns when no access uses the hooks anymore.
+ */
+int ga_add_ioaddr_ops(void __iomem *ioaddr, phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque);
+int ga_remove_ioaddr_ops(void __iomem *ioaddr);
+
+/* Same as ga_add_ioaddr_ops, but replaces the range which was installed before
+ * with ga_set_ioaddr_ops. Passing NULL 'ops' removes that range.
+ */
+int ga_set_ioaddr_ops(void __iomem *ioaddr, phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque);
+
+/* Same as ga_set_ioaddr_ops, but matched by physical address and for 8-bit
+ * accesses only. Every 8-bit access then has to translate its address (page
+ * table walk), prefer ga_add_ioaddr_ops.
+ */
 int ga_set_phys_addr_ops(phys_addr_t addr, phys_addr_t size, struct ga_ioaddr_ops *ops, void *opaque);
 
+/* Posted writes for slow backends (e.g. emulated or bus-bridged registers):
+ * the hooked writes of the range at 'ioaddr' (as passed to ga_add_ioaddr_ops)
+ * are queued (up to 'depth', at most 256) and written to the hooks by a worker
+ * 'delay_us' later, so the writer does not wait for the backend. Call it before
+ * the registers are used, the queue is flushed and freed with the hooks.
+ * Ordering rules:
+ *  - a write to a queued register (same address and size) replaces the queued
+ *    write: the backend sees the last value of every register, in the order of
+ *    these last writes. Do not post registers whose writes have side effects;
+ *  - a read of a queued register returns the queued value, so read/update/write
+ *    works without flushing. The registers must read back what was written;
+ *  - any other read, and any access without a hook, first writes the queue to
+ *    the backend, so reads are ordered after all earlier writes;
+ *  - ga_flush returns once the queued writes of the range of 'ioaddr' have been
+ *    written (e.g. before waiting for the device through another path).
+ * A full queue is written by the writer which fills it.
+ */
+int ga_posted_init(void __iomem *ioaddr, unsigned int depth, unsigned int delay_us);
+int ga_flush(void __iomem *ioaddr);
+
+/* Shadow cache of the registers at [ioaddr, ioaddr + size), which saves the
+ * read of a read/update/write (and of reads) on slow buses. The cache is a range
+ * like the hooks above and may not overlap with one (-EBUSY).
+ * All registers are GA_CACHE_NONE until ga_cache_set_policy marks them:
+ * GA_CACHE_WRITE registers keep their last value for read/update/write, reads
+ * still go to the hardware. GA_CACHE_READ_WRITE registers (non volatile) are
+ * also read from the cache once their value is known.
+ * ga_cache_sync writes all known values back to the hardware (e.g. on resume),
+ * ga_cache_invalidate forgets them (e.g. after a reset of the device).
+ */
+#define GA_CACHE_NONE		0
+#define GA_CACHE_WRITE		1
+#define GA_CACHE_READ_WRITE	2
+
+int ga_cache_init(void __iomem *ioaddr, phys_addr_t size);
+int ga_cache_exit(void __iomem *ioaddr);
+int ga_cache_set_policy(void __iomem *ioaddr, phys_addr_t size, int policy);
+int ga_cache_sync(void __iomem *ioaddr);
+int ga_cache_invalidate(void __iomem *ioaddr);
+
 #define GA_LM_SPINLOCK	0
 #define GA_LM_MUTEX	1
-void ga_set_lock_mode(int mode);
+int ga_set_lock_mode(int mode);
 
 #endif
@@ -0,0 +1,43 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GFIFO_BCAST_H
+#define GFIFO_BCAST_H
+
+/* Broadcast mode of the gfifo drivers, shared with userspace
+ * (test_suite/gfifo_bcast.c).
+ *
+ * ioctl MEM_BROADCAST (0x6) with a policy below switches an empty, non-mapped
+ * byte stream fifo to broadcast mode, GFIFO_BCAST_OFF back. Every open file
+ * which can read then has its own read cursor: each reader gets all the bytes
+ * written after it opened the fifo (or after the switch), at its own pace. A
+ * write is never held back when nobody reads.
+ *
+ * GFIFO_BCAST_BLOCK: writers wait for the slowest reader.
+ * GFIFO_BCAST_OVERRUN: writers never wait, they overwrite the oldest bytes.
+ * A reader which lost bytes gets EPIPE once, then reads on from the oldest
+ * byte still in the fifo.
+ *
+ * The lag of each reader (pid, bytes not read yet, overruns) is shown in the
+ * debugfs statistics. splice() from the fifo, mmap(), MEM_RESIZE and
+ * MEM_RECORD are refused in broadcast mode.
+ */
+
+#define GFIFO_BCAST_OFF		0
+#define GFIFO_BCAST_OVERRUN	1
+#define GFIFO_BCAST_BLOCK	2
+
+#endif
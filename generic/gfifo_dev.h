@@ -0,0 +1,341 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef KERNEL_GFIFO_DEV_H
+#define KERNEL_GFIFO_DEV_H
+
+/* The part of a device which is the same in all gfifo drivers: the ring, its
+ * statistics, the mutex which serializes them, the wait queues and the SIGIO
+ * queue, with the read, write, ioctl and poll bodies on top of them. A driver
+ * embeds a struct gfifo_core in its device, finds it from the file and calls
+ * the gfifo_core_* helpers from its file_operations.
+ *
+ * notify_readers and notify_writers are called under the mutex when data was
+ * added or room was made (write, read, ioctl, release). When NULL the sleepers
+ * are woken up and SIGIO is sent at once.
+ */
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/uio.h>
+#include <linux/uaccess.h>
+#include <linux/sched/signal.h>
+#include "gfifo_ring.h"
+#include "gfifo_stats.h"
+
+#define MEM_CLEAR 0x1
+#define MEM_RESIZE 0x2
+#define MEM_NOTIFY 0x3
+#define MEM_RECORD 0x4
+#define MEM_READ_BATCH 0x5
+#define MEM_BROADCAST 0x6
+
+struct gfifo_core {
+	struct mutex mutex;
+	struct gfifo_ring ring;
+	struct gfifo_stats stats;
+	wait_queue_head_t r_wait;
+	wait_queue_head_t w_wait;
+	struct fasync_struct *async_queue;
+	void (*notify_readers)(struct gfifo_core *fifo);
+	void (*notify_writers)(struct gfifo_core *fifo);
+};
+
+static inline int gfifo_core_init(struct gfifo_core *fifo, unsigned long size)
+{
+	int ret = gfifo_ring_alloc(&fifo->ring, size);
+
+	if (ret)
+		return ret;
+	mutex_init(&fifo->mutex);
+	init_waitqueue_head(&fifo->r_wait);
+	init_waitqueue_head(&fifo->w_wait);
+	return 0;
+}
+
+static inline void gfifo_core_free(struct gfifo_core *fifo)
+{
+	mutex_destroy(&fifo->mutex);
+	gfifo_ring_free(&fifo->ring);
+}
+
+/* Data was added */
+static inline void gfifo_core_notify_readers(struct gfifo_core *fifo)
+{
+	if (fifo->notify_readers) {
+		fifo->notify_readers(fifo);
+		return;
+	}
+	gfifo_wake_up(&fifo->stats, &fifo->r_wait);
+	gfifo_kill_fasync(&fifo->stats, &fifo->async_queue, POLL_IN);
+}
+
+/* Room was made */
+static inline void gfifo_core_notify_writers(struct gfifo_core *fifo)
+{
+	if (fifo->notify_writers) {
+		fifo->notify_writers(fifo);
+		return;
+	}
+	gfifo_wake_up(&fifo->stats, &fifo->w_wait);
+	gfifo_kill_fasync(&fifo->stats, &fifo->async_queue, POLL_OUT);
+}
+
+static inline int gfifo_core_open(struct gfifo_core *fifo, struct file *filp)
+{
+	int ret;
+
+	filp->f_mode |= FMODE_NOWAIT;
+
+	mutex_lock(&fifo->mutex);
+	ret = gfifo_ring_add_reader(&fifo->ring, filp);
+	mutex_unlock(&fifo->mutex);
+	return ret;
+}
+
+/* A broadcast reader which goes away may be the one the writers wait for */
+static inline void gfifo_core_release(struct gfifo_core *fifo, struct file *filp)
+{
+	fasync_helper(-1, filp, 0, &fifo->async_queue);
+	mutex_lock(&fifo->mutex);
+	gfifo_ring_del_reader(&fifo->ring, filp);
+	gfifo_core_notify_writers(fifo);
+	mutex_unlock(&fifo->mutex);
+}
+
+/* Wait until 'cond' holds, called with the mutex held and the task on the
+ * wait queue. Returns 0 or -EAGAIN with the mutex held, -ERESTARTSYS without.
+ */
+#define gfifo_core_wait(__fifo, __cond, __nonblock, __write)				\
+({											\
+	int __ret = 0;									\
+	u64 __start;									\
+	while (!(__cond)) {								\
+		if (__nonblock) {							\
+			(__fifo)->stats.eagain++;					\
+			__ret = -EAGAIN;						\
+			break;								\
+		}									\
+		__set_current_state(TASK_INTERRUPTIBLE);				\
+		mutex_unlock(&(__fifo)->mutex);						\
+		__start = ktime_get_ns();						\
+		schedule();								\
+		if (signal_pending(current)) {						\
+			__ret = -ERESTARTSYS;						\
+			break;								\
+		}									\
+		mutex_lock(&(__fifo)->mutex);						\
+		gfifo_stats_block(&(__fifo)->stats, __write, __start);			\
+	}										\
+	__ret;										\
+})
+
+/* MEM_READ_BATCH: whole records, see gfifo_record.h */
+static inline long gfifo_core_read_batch(struct gfifo_core *fifo, struct file *filp, void __user *argp)
+{
+	struct gfifo_read_batch batch;
+	long ret;
+	DECLARE_WAITQUEUE(wait, current);
+
+	if (copy_from_user(&batch, argp, sizeof(batch)))
+		return -EFAULT;
+
+	mutex_lock(&fifo->mutex);
+	add_wait_queue(&fifo->r_wait, &wait);
+
+	ret = gfifo_core_wait(fifo, !gfifo_ring_is_empty(&fifo->ring),
+		filp->f_flags & O_NONBLOCK, false);
+	if (ret == -ERESTARTSYS)
+		goto out;
+	if (ret == 0) {
+		ret = gfifo_ring_records_to_user(&fifo->ring, &batch);
+		if (ret == 0) {
+			gfifo_stats_read(&fifo->stats, batch.bytes, gfifo_ring_len(&fifo->ring));
+			gfifo_core_notify_writers(fifo);
+		}
+	}
+	mutex_unlock(&fifo->mutex);
+
+out:
+	remove_wait_queue(&fifo->r_wait, &wait);
+	__set_current_state(TASK_RUNNING);
+	if ((ret == 0) && copy_to_user(argp, &batch, sizeof(batch)))
+		ret = -EFAULT;
+	return ret;
+}
+
+/* The ioctls of all the drivers, -EINVAL for the others */
+static inline long gfifo_core_ioctl(struct gfifo_core *fifo, struct file *filp, unsigned int cmd,
+	unsigned long arg)
+{
+	int ret;
+
+	switch (cmd) {
+	case MEM_CLEAR:
+		mutex_lock(&fifo->mutex);
+		memset(fifo->ring.buf, 0, fifo->ring.size);
+		mutex_unlock(&fifo->mutex);
+		printk(KERN_INFO "gfifo is set to 0\n");
+		break;
+	case MEM_RESIZE:
+		mutex_lock(&fifo->mutex);
+		ret = gfifo_ring_resize(&fifo->ring, arg);
+		if (ret == 0)
+			gfifo_core_notify_writers(fifo);
+		mutex_unlock(&fifo->mutex);
+		if (ret)
+			return ret;
+		break;
+	case MEM_NOTIFY:
+		/* A mapped producer or consumer moved 'in' or 'out' */
+		mutex_lock(&fifo->mutex);
+		if (!gfifo_ring_is_empty(&fifo->ring))
+			gfifo_core_notify_readers(fifo);
+		if (!gfifo_ring_is_full(&fifo->ring))
+			gfifo_core_notify_writers(fifo);
+		mutex_unlock(&fifo->mutex);
+		break;
+	case MEM_RECORD:
+		mutex_lock(&fifo->mutex);
+		ret = gfifo_ring_set_record(&fifo->ring, arg);
+		mutex_unlock(&fifo->mutex);
+		if (ret)
+			return ret;
+		break;
+	case MEM_READ_BATCH:
+		return gfifo_core_read_batch(fifo, filp, (void __user *)arg);
+	case MEM_BROADCAST:
+		mutex_lock(&fifo->mutex);
+		ret = gfifo_ring_set_bcast(&fifo->ring, arg);
+		mutex_unlock(&fifo->mutex);
+		if (ret)
+			return ret;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static inline ssize_t gfifo_core_read_iter(struct gfifo_core *fifo, struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *filp = iocb->ki_filp;
+	unsigned int count;
+	ssize_t ret;
+	DECLARE_WAITQUEUE(wait, current);
+
+	/* IOCB_NOWAIT (io_uring inline issue): never sleep, not even on the mutex */
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		if (!mutex_trylock(&fifo->mutex))
+			return -EAGAIN;
+	} else
+		mutex_lock(&fifo->mutex);
+	add_wait_queue(&fifo->r_wait, &wait);
+
+	ret = gfifo_core_wait(fifo, gfifo_ring_readable(&fifo->ring, filp),
+		(filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT), false);
+	if (ret == -ERESTARTSYS)
+		goto out;
+	if (ret)
+		goto unlock;
+
+	/* Records would lose their framing in a pipe, and broadcast readers
+	 * only read() like before. Checked after the wait, under the mutex.
+	 */
+	if (gfifo_iocb_is_splice(iocb, to) && (fifo->ring.record || fifo->ring.bcast)) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	ret = gfifo_ring_to_iter(&fifo->ring, filp, to, &count);
+	if (ret == 0) {
+		gfifo_stats_read(&fifo->stats, count, gfifo_ring_len(&fifo->ring));
+		gfifo_core_notify_writers(fifo);
+		ret = count;
+	}
+
+unlock:
+	mutex_unlock(&fifo->mutex);
+out:
+	remove_wait_queue(&fifo->r_wait, &wait);
+	__set_current_state(TASK_RUNNING);
+	return ret;
+}
+
+static inline ssize_t gfifo_core_write_iter(struct gfifo_core *fifo, struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *filp = iocb->ki_filp;
+	unsigned int count;
+	ssize_t ret;
+	DECLARE_WAITQUEUE(wait, current);
+
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		if (!mutex_trylock(&fifo->mutex))
+			return -EAGAIN;
+	} else
+		mutex_lock(&fifo->mutex);
+	add_wait_queue(&fifo->w_wait, &wait);
+
+	ret = gfifo_core_wait(fifo, gfifo_ring_writable(&fifo->ring, iov_iter_count(from)),
+		(filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT), true);
+	if (ret == -ERESTARTSYS)
+		goto out;
+	if (ret)
+		goto unlock;
+
+	/* A record would be cut at the pipe buffers */
+	if (gfifo_iocb_is_splice(iocb, from) && fifo->ring.record) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	ret = gfifo_ring_from_iter(&fifo->ring, from, &count);
+	if (ret == 0) {
+		gfifo_stats_write(&fifo->stats, count, gfifo_ring_len(&fifo->ring));
+		gfifo_core_notify_readers(fifo);
+		ret = count;
+	}
+
+unlock:
+	mutex_unlock(&fifo->mutex);
+out:
+	remove_wait_queue(&fifo->w_wait, &wait);
+	__set_current_state(TASK_RUNNING);
+	return ret;
+}
+
+static inline unsigned int gfifo_core_poll(struct gfifo_core *fifo, struct file *filp, poll_table *p)
+{
+	unsigned int mask = 0;
+
+	mutex_lock(&fifo->mutex);
+
+	poll_wait(filp, &fifo->r_wait, p);
+	poll_wait(filp, &fifo->w_wait, p);
+
+	if (gfifo_ring_readable(&fifo->ring, filp))
+		mask |= POLLIN|POLLRDNORM;
+	if (gfifo_ring_writable(&fifo->ring, 1))
+		mask |= POLLOUT|POLLWRNORM;
+
+	mutex_unlock(&fifo->mutex);
+	return mask;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GFIFO_MMAP_H
+#define GFIFO_MMAP_H
+
+/* Shared memory ring of the gfifo drivers, shared with userspace
+ * (test_suite/gfifo_mmap_bench.c).
+ *
+ * mmap() of a gfifo maps a control page at offset 0, followed by the data ring
+ * at offset GFIFO_MMAP_DATA_OFFSET (map PAGE_SIZE + size bytes). 'in' and 'out'
+ * count the bytes written and read, the data of byte i is at (i & (size - 1)).
+ * They are the indices read()/write() use too, so mapped and non-mapped
+ * producers and consumers can be mixed, one of each.
+ *
+ * A mapped producer copies its data to the ring, then stores 'in' (release).
+ * A mapped consumer loads 'in' (acquire), copies the data, then stores 'out'.
+ * The kernel is only told about the transitions which can have waiters, with
+ * ioctl MEM_NOTIFY (0x3): the producer after making an empty ring non-empty
+ * (after its store of 'in' and a full barrier, 'out' equals the previous
+ * 'in'), the consumer after making a full ring non-full. The kernel then wakes
+ * up poll(), blocked read()/write() and sends SIGIO (gfifo drivers with
+ * fasync). A process waits with poll().
+ * The ring cannot be resized while it is mapped (-EBUSY).
+ */
+#include <linux/types.h>
+
+#define GFIFO_MMAP_DATA_OFFSET	4096	/* PAGE_SIZE of the supported targets */
+
+struct gfifo_ring_ctrl {
+	__u32	in;		/* written by the producer */
+	__u32	reserved0[15];
+	__u32	out;		/* written by the consumer */
+	__u32	reserved1[15];
+	__u32	size;		/* bytes in the ring, a power of 2 */
+	__u32	reserved2[15];
+};
+
+#endif
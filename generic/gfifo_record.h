@@ -0,0 +1,56 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GFIFO_RECORD_H
+#define GFIFO_RECORD_H
+
+/* Record mode of the gfifo drivers, shared with userspace
+ * (test_suite/gfifo_record.c).
+ *
+ * ioctl MEM_RECORD (0x4) with 1 switches an empty, non-mapped fifo to record
+ * mode, 0 back to a byte stream. In record mode every write() is one record,
+ * stored in the ring behind a native endian __u32 length. A write blocks (or
+ * fails with EAGAIN) until the whole record fits, EMSGSIZE if it can never
+ * fit; empty writes store nothing. Each read() returns exactly one record,
+ * EMSGSIZE (and the record stays) if the buffer is too small.
+ *
+ * ioctl MEM_READ_BATCH (0x5) takes a struct gfifo_read_batch and returns as
+ * many whole records as fit in 'buf' and 'index' in one call, blocking (unless
+ * O_NONBLOCK) until there is at least one. The payloads are stored back to
+ * back, index[i] gives where record i is. EMSGSIZE if the first record does
+ * not fit in 'buf'.
+ *
+ * splice() and mmap() are refused in record mode.
+ */
+#include <linux/types.h>
+
+#define GFIFO_RECORD_HDR	sizeof(__u32)
+
+struct gfifo_record_index {
+	__u32	offset;		/* in buf */
+	__u32	len;
+};
+
+struct gfifo_read_batch {
+	__u64	buf;		/* payloads */
+	__u64	index;		/* struct gfifo_record_index[max_records] */
+	__u32	buf_len;
+	__u32	max_records;
+	__u32	records;	/* returned records */
+	__u32	bytes;		/* bytes used in buf */
+};
+
+#endif
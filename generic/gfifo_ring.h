@@ -0,0 +1,630 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef KERNEL_GFIFO_RING_H
+#define KERNEL_GFIFO_RING_H
+
+/* Byte ring of the gfifo drivers.
+ *
+ * 'in' and 'out' count the bytes written and read since the ring was reset and
+ * wrap around naturally, their difference is the fill level. The size is a
+ * power of 2, so the offset in the buffer is a mask. Reads and writes copy at
+ * most two chunks (up to the end of the buffer, then from its start), so their
+ * cost does not depend on the fill level. A read or write fills or drains a
+ * whole iov_iter (readv/writev, io_uring) in one go. The caller serializes
+ * the accesses (dev->mutex).
+ *
+ * The buffer is allocated with gfifo_ring_alloc: the size is rounded up to a
+ * power of 2 and the buffer is vmalloc'ed, so a fifo can be several megabytes.
+ * gfifo_ring_resize moves the content to a new buffer.
+ *
+ * 'in' and 'out' live in a control page in front of the buffer, so the ring can
+ * be mmap'ed by the producer and the consumer (see gfifo_mmap.h). A process
+ * may then store them at any time: they are loaded once per access and the
+ * fill level is clamped to the size.
+ *
+ * splice() goes through the iov_iter paths (copy_splice_read,
+ * iter_file_splice_write), see gfifo_iocb_is_splice.
+ *
+ * In record mode (see gfifo_record.h) the iov_iter helpers move whole
+ * length-prefixed records, gfifo_ring_writable tells a writer whether its
+ * record fits.
+ *
+ * In broadcast mode (see gfifo_bcast.h) every reading file has a struct
+ * gfifo_reader with its own cursor, registered at open. 'out' is then the
+ * cursor of the slowest reader, readers which were overrun do not count. The
+ * readers are found by their file: a broadcast fifo has a handful of them.
+ */
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/atomic.h>
+#include <linux/version.h>
+#include "kernel_compat.h"
+#include "gfifo_mmap.h"
+#include "gfifo_record.h"
+#include "gfifo_bcast.h"
+
+#define GFIFO_RING_MAX_SIZE	(64 << 20)
+
+struct gfifo_ring {
+	struct gfifo_ring_ctrl	*ctrl;		/* control page, followed by buf */
+	unsigned char		*buf;
+	unsigned int		size;		/* a power of 2 */
+	struct mutex		map_lock;	/* mmap vs. resize */
+	atomic_t		mapped;		/* vmas mapping the ring */
+	bool			record;		/* record mode */
+	unsigned int		bcast;		/* GFIFO_BCAST_* policy */
+	struct list_head	readers;	/* struct gfifo_reader */
+};
+
+struct gfifo_reader {
+	struct list_head	node;
+	struct file		*filp;
+	pid_t			pid;
+	unsigned int		out;		/* read cursor in broadcast mode */
+	u64			overruns;
+};
+
+static inline int __gfifo_ring_alloc(struct gfifo_ring *ring, unsigned long size)
+{
+	if ((size == 0) || (size > GFIFO_RING_MAX_SIZE))
+		return -EINVAL;
+	size = roundup_pow_of_two(size);
+
+	/* Zeroed pages which can be mapped to userspace */
+	BUILD_BUG_ON(sizeof(struct gfifo_ring_ctrl) > PAGE_SIZE);
+	BUILD_BUG_ON(GFIFO_MMAP_DATA_OFFSET != PAGE_SIZE);
+	ring->ctrl = vmalloc_user(PAGE_SIZE + PAGE_ALIGN(size));
+	if (!ring->ctrl)
+		return -ENOMEM;
+
+	ring->buf = (unsigned char *)ring->ctrl + PAGE_SIZE;
+	ring->size = size;
+	ring->ctrl->size = size;
+	return 0;
+}
+
+static inline int gfifo_ring_alloc(struct gfifo_ring *ring, unsigned long size)
+{
+	mutex_init(&ring->map_lock);
+	atomic_set(&ring->mapped, 0);
+	ring->record = false;
+	ring->bcast = GFIFO_BCAST_OFF;
+	INIT_LIST_HEAD(&ring->readers);
+	return __gfifo_ring_alloc(ring, size);
+}
+
+static inline void gfifo_ring_free(struct gfifo_ring *ring)
+{
+	vfree(ring->ctrl);
+	ring->ctrl = NULL;
+	ring->buf = NULL;
+}
+
+static inline unsigned int gfifo_ring_len(const struct gfifo_ring *ring)
+{
+	return min(READ_ONCE(ring->ctrl->in) - READ_ONCE(ring->ctrl->out), ring->size);
+}
+
+static inline unsigned int gfifo_ring_avail(const struct gfifo_ring *ring)
+{
+	return ring->size - gfifo_ring_len(ring);
+}
+
+static inline bool gfifo_ring_is_empty(const struct gfifo_ring *ring)
+{
+	return gfifo_ring_len(ring) == 0;
+}
+
+static inline bool gfifo_ring_is_full(const struct gfifo_ring *ring)
+{
+	return gfifo_ring_len(ring) == ring->size;
+}
+
+/* Change the size, the content is kept (-EBUSY if it does not fit, if the
+ * ring is mapped or in broadcast mode)
+ */
+static inline int gfifo_ring_resize(struct gfifo_ring *ring, unsigned long size)
+{
+	struct gfifo_ring new;
+	unsigned int len = gfifo_ring_len(ring);
+	unsigned int off = READ_ONCE(ring->ctrl->out) & (ring->size - 1);
+	unsigned int first = min(len, ring->size - off);
+	int ret;
+
+	mutex_lock(&ring->map_lock);
+	if (atomic_read(&ring->mapped) || ring->bcast) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = __gfifo_ring_alloc(&new, size);
+	if (ret)
+		goto out;
+	if (len > new.size) {
+		gfifo_ring_free(&new);
+		ret = -EBUSY;
+		goto out;
+	}
+
+	memcpy(new.buf, ring->buf + off, first);
+	memcpy(new.buf + first, ring->buf, len - first);
+	new.ctrl->in = len;
+
+	gfifo_ring_free(ring);
+	ring->ctrl = new.ctrl;
+	ring->buf = new.buf;
+	ring->size = new.size;
+out:
+	mutex_unlock(&ring->map_lock);
+	return ret;
+}
+
+static inline void gfifo_ring_vm_open(struct vm_area_struct *vma)
+{
+	struct gfifo_ring *ring = vma->vm_private_data;
+
+	atomic_inc(&ring->mapped);
+}
+
+static inline void gfifo_ring_vm_close(struct vm_area_struct *vma)
+{
+	struct gfifo_ring *ring = vma->vm_private_data;
+
+	atomic_dec(&ring->mapped);
+}
+
+static const struct vm_operations_struct gfifo_ring_vm_ops = {
+	.open	= gfifo_ring_vm_open,
+	.close	= gfifo_ring_vm_close,
+};
+
+/* Map the control page and the buffer. Called without dev->mutex: mmap() runs
+ * with the mmap lock held, and read()/write() fault on user memory (which
+ * takes the mmap lock) while they hold dev->mutex.
+ */
+static inline int gfifo_ring_mmap(struct gfifo_ring *ring, struct vm_area_struct *vma)
+{
+	int ret = -EINVAL;
+
+	/* map_lock orders this against gfifo_ring_set_record/set_bcast */
+	mutex_lock(&ring->map_lock);
+	if (!ring->record && !ring->bcast)
+		ret = remap_vmalloc_range(vma, ring->ctrl, vma->vm_pgoff);
+	if (ret == 0) {
+		vma->vm_private_data = ring;
+		vma->vm_ops = &gfifo_ring_vm_ops;
+		gfifo_ring_vm_open(vma);
+	}
+	mutex_unlock(&ring->map_lock);
+	return ret;
+}
+
+static inline struct gfifo_reader *gfifo_ring_reader(const struct gfifo_ring *ring, const struct file *filp)
+{
+	struct gfifo_reader *r;
+
+	list_for_each_entry(r, &ring->readers, node)
+		if (r->filp == filp)
+			return r;
+	return NULL;
+}
+
+/* Bytes a broadcast reader has not read yet, more than the size if it was
+ * overrun
+ */
+static inline unsigned int gfifo_ring_reader_lag(const struct gfifo_ring *ring, const struct gfifo_reader *r)
+{
+	return READ_ONCE(ring->ctrl->in) - r->out;
+}
+
+static inline bool gfifo_ring_reader_overrun(const struct gfifo_ring *ring, const struct gfifo_reader *r)
+{
+	return (int)(READ_ONCE(ring->ctrl->out) - r->out) > 0;
+}
+
+/* Move 'out' to the slowest reader which was not overrun, all the data is
+ * dropped when there are no readers
+ */
+static inline void gfifo_ring_bcast_tail(struct gfifo_ring *ring)
+{
+	unsigned int in = READ_ONCE(ring->ctrl->in);
+	unsigned int out = READ_ONCE(ring->ctrl->out);
+	unsigned int lag = 0;
+	struct gfifo_reader *r;
+
+	list_for_each_entry(r, &ring->readers, node)
+		lag = max(lag, min(in - r->out, in - out));
+	smp_store_release(&ring->ctrl->out, in - lag);
+}
+
+/* Make room for a write of 'count' bytes: in GFIFO_BCAST_OVERRUN the oldest
+ * bytes are dropped, the readers still needing them are overrun
+ */
+static inline void gfifo_ring_bcast_make_room(struct gfifo_ring *ring, size_t count)
+{
+	unsigned int in = READ_ONCE(ring->ctrl->in);
+	unsigned int need = min_t(size_t, count, ring->size);
+
+	if (list_empty(&ring->readers))
+		smp_store_release(&ring->ctrl->out, in);
+	else if ((ring->bcast == GFIFO_BCAST_OVERRUN) && (gfifo_ring_avail(ring) < need))
+		smp_store_release(&ring->ctrl->out, in + need - ring->size);
+}
+
+/* Register a file which can read (open), -ENOMEM. A new reader starts at the
+ * current write index.
+ */
+static inline int gfifo_ring_add_reader(struct gfifo_ring *ring, struct file *filp)
+{
+	struct gfifo_reader *r;
+
+	if (!(filp->f_mode & FMODE_READ))
+		return 0;
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+	r->filp = filp;
+	r->pid = task_tgid_nr(current);
+	r->out = READ_ONCE(ring->ctrl->in);
+	list_add_tail(&r->node, &ring->readers);
+	return 0;
+}
+
+/* Unregister a file (release), in broadcast mode the bytes only it was
+ * waiting for are freed
+ */
+static inline void gfifo_ring_del_reader(struct gfifo_ring *ring, struct file *filp)
+{
+	struct gfifo_reader *r = gfifo_ring_reader(ring, filp);
+
+	if (!r)
+		return;
+	list_del(&r->node);
+	kfree(r);
+	if (ring->bcast)
+		gfifo_ring_bcast_tail(ring);
+}
+
+/* Switch to a broadcast policy or back, only while the ring is empty, not
+ * mapped and not in record mode (-EBUSY). The readers start at the write
+ * index.
+ */
+static inline int gfifo_ring_set_bcast(struct gfifo_ring *ring, unsigned long policy)
+{
+	struct gfifo_reader *r;
+	int ret = 0;
+
+	if (policy > GFIFO_BCAST_BLOCK)
+		return -EINVAL;
+
+	mutex_lock(&ring->map_lock);
+	if (atomic_read(&ring->mapped) || !gfifo_ring_is_empty(ring) || ring->record) {
+		ret = -EBUSY;
+	} else {
+		ring->bcast = policy;
+		list_for_each_entry(r, &ring->readers, node) {
+			r->out = READ_ONCE(ring->ctrl->in);
+			r->overruns = 0;
+		}
+	}
+	mutex_unlock(&ring->map_lock);
+	return ret;
+}
+
+/* Whether a read by 'filp' can proceed: the ring is not empty, or in
+ * broadcast mode the reader has bytes to read or was overrun
+ */
+static inline bool gfifo_ring_readable(const struct gfifo_ring *ring, const struct file *filp)
+{
+	const struct gfifo_reader *r;
+
+	if (!ring->bcast)
+		return !gfifo_ring_is_empty(ring);
+	r = gfifo_ring_reader(ring, filp);
+	return r && (gfifo_ring_reader_lag(ring, r) || gfifo_ring_reader_overrun(ring, r));
+}
+
+/* Copy from the cursor of a broadcast reader, like gfifo_ring_to_iter. An
+ * overrun reader is moved to 'out' and gets -EPIPE.
+ */
+static inline int gfifo_ring_bcast_to_iter(struct gfifo_ring *ring, struct gfifo_reader *r,
+	struct iov_iter *to, unsigned int *copied)
+{
+	unsigned int in = smp_load_acquire(&ring->ctrl->in);
+	unsigned int off = r->out & (ring->size - 1);
+	unsigned int count, first, n;
+
+	if (gfifo_ring_reader_overrun(ring, r)) {
+		r->out = READ_ONCE(ring->ctrl->out);
+		r->overruns++;
+		return -EPIPE;
+	}
+
+	count = min_t(size_t, iov_iter_count(to), min(in - r->out, ring->size));
+	first = min(count, ring->size - off);
+	n = copy_to_iter(ring->buf + off, first, to);
+	if (n == first)
+		n += copy_to_iter(ring->buf, count - first, to);
+	if ((n == 0) && (count != 0))
+		return -EFAULT;
+
+	r->out += n;
+	gfifo_ring_bcast_tail(ring);
+	*copied = n;
+	return 0;
+}
+
+/* copy_splice_read and iter_file_splice_write move the data between a pipe and
+ * the iov_iter paths with synchronous reads and writes of kernel pages: an
+ * ITER_BVEC, or an ITER_PIPE for the reads before 6.5 (generic_file_splice_read).
+ * kernel_read/kernel_write use an ITER_KVEC and are not splices. Only the
+ * caller (read_iter/write_iter) knows the mode under its lock, so it refuses
+ * the splices which do not fit the mode.
+ */
+static inline bool gfifo_iocb_is_splice(const struct kiocb *iocb, const struct iov_iter *i)
+{
+	return is_sync_kiocb((struct kiocb *)iocb) &&
+		(iov_iter_is_bvec(i) || iov_iter_is_pipe(i));
+}
+
+/* Switch between byte stream and record mode, only while the ring is empty,
+ * not mapped and not in broadcast mode (-EBUSY)
+ */
+static inline int gfifo_ring_set_record(struct gfifo_ring *ring, bool record)
+{
+	int ret = 0;
+
+	mutex_lock(&ring->map_lock);
+	if (atomic_read(&ring->mapped) || !gfifo_ring_is_empty(ring) || ring->bcast)
+		ret = -EBUSY;
+	else
+		ring->record = record;
+	mutex_unlock(&ring->map_lock);
+	return ret;
+}
+
+/* Whether a write of 'count' bytes can proceed: the ring is not full, or in
+ * record mode the whole record fits. Also true for a record which can never
+ * fit, the write then fails with -EMSGSIZE. A broadcast write only waits for
+ * readers in GFIFO_BCAST_BLOCK.
+ */
+static inline bool gfifo_ring_writable(const struct gfifo_ring *ring, size_t count)
+{
+	if (ring->bcast && ((ring->bcast == GFIFO_BCAST_OVERRUN) || list_empty(&ring->readers)))
+		return true;
+	if (!ring->record)
+		return !gfifo_ring_is_full(ring);
+	if (count > ring->size - GFIFO_RECORD_HDR)
+		return true;
+	return gfifo_ring_avail(ring) >= GFIFO_RECORD_HDR + count;
+}
+
+/* Copy 'count' bytes at the absolute index 'pos' to or from kernel memory */
+static inline void __gfifo_ring_get(const struct gfifo_ring *ring, unsigned int pos, void *dst,
+	unsigned int count)
+{
+	unsigned int off = pos & (ring->size - 1);
+	unsigned int first = min(count, ring->size - off);
+
+	memcpy(dst, ring->buf + off, first);
+	memcpy(dst + first, ring->buf, count - first);
+}
+
+static inline void __gfifo_ring_put(struct gfifo_ring *ring, unsigned int pos, const void *src,
+	unsigned int count)
+{
+	unsigned int off = pos & (ring->size - 1);
+	unsigned int first = min(count, ring->size - off);
+
+	memcpy(ring->buf + off, src, first);
+	memcpy(ring->buf, src + first, count - first);
+}
+
+/* Length of the record at 'pos', -1 if there is none complete before 'in' */
+static inline long __gfifo_ring_record_len(const struct gfifo_ring *ring, unsigned int pos,
+	unsigned int in)
+{
+	unsigned int avail = min(in - pos, ring->size);
+	u32 len;
+
+	if (avail < GFIFO_RECORD_HDR)
+		return -1;
+	__gfifo_ring_get(ring, pos, &len, GFIFO_RECORD_HDR);
+	if (len > avail - GFIFO_RECORD_HDR)
+		return -1;
+	return len;
+}
+
+/* Read one record, -EMSGSIZE if it does not fit in the iov_iter */
+static inline int gfifo_ring_record_to_iter(struct gfifo_ring *ring, struct iov_iter *to, unsigned int *copied)
+{
+	unsigned int in = smp_load_acquire(&ring->ctrl->in);
+	unsigned int out = READ_ONCE(ring->ctrl->out);
+	unsigned int off = (out + GFIFO_RECORD_HDR) & (ring->size - 1);
+	long len = __gfifo_ring_record_len(ring, out, in);
+	unsigned int first, n;
+
+	if (len < 0) {
+		*copied = 0;
+		return 0;
+	}
+	if ((size_t)len > iov_iter_count(to))
+		return -EMSGSIZE;
+
+	first = min_t(unsigned int, len, ring->size - off);
+	n = copy_to_iter(ring->buf + off, first, to);
+	if (n == first)
+		n += copy_to_iter(ring->buf, len - first, to);
+	if (n != len)
+		return -EFAULT;
+
+	smp_store_release(&ring->ctrl->out, out + GFIFO_RECORD_HDR + len);
+	*copied = len;
+	return 0;
+}
+
+/* Write the iov_iter as one record. The caller waited for gfifo_ring_writable,
+ * nothing is stored on -EFAULT.
+ */
+static inline int gfifo_ring_record_from_iter(struct gfifo_ring *ring, struct iov_iter *from,
+	unsigned int *copied)
+{
+	unsigned int in = READ_ONCE(ring->ctrl->in);
+	unsigned int out = smp_load_acquire(&ring->ctrl->out);
+	unsigned int off = (in + GFIFO_RECORD_HDR) & (ring->size - 1);
+	size_t count = iov_iter_count(from);
+	unsigned int first, n;
+	u32 len = count;
+
+	if (count > ring->size - GFIFO_RECORD_HDR)
+		return -EMSGSIZE;
+	*copied = 0;
+	if ((count == 0) || (ring->size - min(in - out, ring->size) < GFIFO_RECORD_HDR + count))
+		return 0;
+
+	first = min_t(unsigned int, count, ring->size - off);
+	n = copy_from_iter(ring->buf + off, first, from);
+	if (n == first)
+		n += copy_from_iter(ring->buf, count - first, from);
+	if (n != count)
+		return -EFAULT;
+	__gfifo_ring_put(ring, in, &len, GFIFO_RECORD_HDR);
+
+	smp_store_release(&ring->ctrl->in, in + GFIFO_RECORD_HDR + count);
+	*copied = count;
+	return 0;
+}
+
+/* Read as many whole records as fit in the buffers of a batch (MEM_READ_BATCH),
+ * 'records' and 'bytes' are set. -EMSGSIZE if the first record does not fit,
+ * -EINVAL in byte stream mode.
+ */
+static inline int gfifo_ring_records_to_user(struct gfifo_ring *ring, struct gfifo_read_batch *batch)
+{
+	char __user *buf = u64_to_user_ptr(batch->buf);
+	struct gfifo_record_index __user *index = u64_to_user_ptr(batch->index);
+	unsigned int in = smp_load_acquire(&ring->ctrl->in);
+	unsigned int out = READ_ONCE(ring->ctrl->out);
+	unsigned int pos = out;
+	int ret = 0;
+	long len;
+
+	if (!ring->record)
+		return -EINVAL;
+
+	batch->records = 0;
+	batch->bytes = 0;
+	while ((batch->records < batch->max_records) && ((len = __gfifo_ring_record_len(ring, pos, in)) >= 0)) {
+		struct gfifo_record_index ix = { .offset = batch->bytes, .len = len };
+		unsigned int off = (pos + GFIFO_RECORD_HDR) & (ring->size - 1);
+		unsigned int first = min_t(unsigned int, len, ring->size - off);
+
+		if ((unsigned long)len > batch->buf_len - batch->bytes) {
+			if (batch->records == 0)
+				ret = -EMSGSIZE;
+			break;
+		}
+		if (copy_to_user(buf + batch->bytes, ring->buf + off, first) ||
+		    copy_to_user(buf + batch->bytes + first, ring->buf, len - first) ||
+		    copy_to_user(&index[batch->records], &ix, sizeof(ix))) {
+			if (batch->records == 0)
+				ret = -EFAULT;
+			break;
+		}
+		batch->records++;
+		batch->bytes += len;
+		pos += GFIFO_RECORD_HDR + len;
+	}
+
+	smp_store_release(&ring->ctrl->out, pos);
+	return ret;
+}
+
+/* Copy as much as fits into an iov_iter (all its segments at once), '*copied'
+ * is set to the number of bytes read (one record in record mode, from the
+ * cursor of 'filp' in broadcast mode). The bytes copied before a fault are
+ * consumed, -EFAULT if there are none.
+ */
+static inline int gfifo_ring_to_iter(struct gfifo_ring *ring, struct file *filp, struct iov_iter *to,
+	unsigned int *copied)
+{
+	unsigned int in = smp_load_acquire(&ring->ctrl->in);
+	unsigned int out = READ_ONCE(ring->ctrl->out);
+	unsigned int off = out & (ring->size - 1);
+	unsigned int count, first, n;
+
+	if (ring->record)
+		return gfifo_ring_record_to_iter(ring, to, copied);
+	if (ring->bcast) {
+		struct gfifo_reader *r = gfifo_ring_reader(ring, filp);
+
+		return r ? gfifo_ring_bcast_to_iter(ring, r, to, copied) : -EBADF;
+	}
+
+	count = min_t(size_t, iov_iter_count(to), min(in - out, ring->size));
+	first = min(count, ring->size - off);
+	n = copy_to_iter(ring->buf + off, first, to);
+	if (n == first)
+		n += copy_to_iter(ring->buf, count - first, to);
+	if ((n == 0) && (count != 0))
+		return -EFAULT;
+
+	smp_store_release(&ring->ctrl->out, out + n);
+	*copied = n;
+	return 0;
+}
+
+/* Copy as much as fits from an iov_iter, '*copied' is set to the number of
+ * bytes written. The bytes copied before a fault are added, -EFAULT if there
+ * are none.
+ */
+static inline int gfifo_ring_from_iter(struct gfifo_ring *ring, struct iov_iter *from, unsigned int *copied)
+{
+	unsigned int in = READ_ONCE(ring->ctrl->in);
+	unsigned int out, off = in & (ring->size - 1);
+	unsigned int count, first, n;
+
+	if (ring->record)
+		return gfifo_ring_record_from_iter(ring, from, copied);
+	if (ring->bcast)
+		gfifo_ring_bcast_make_room(ring, iov_iter_count(from));
+	out = smp_load_acquire(&ring->ctrl->out);
+
+	count = min_t(size_t, iov_iter_count(from), ring->size - min(in - out, ring->size));
+	first = min(count, ring->size - off);
+	n = copy_from_iter(ring->buf + off, first, from);
+	if (n == first)
+		n += copy_from_iter(ring->buf, count - first, from);
+	if ((n == 0) && (count != 0))
+		return -EFAULT;
+
+	smp_store_release(&ring->ctrl->in, in + n);
+	*copied = n;
+	return 0;
+}
+
+#endif
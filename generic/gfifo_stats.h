@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef KERNEL_GFIFO_STATS_H
+#define KERNEL_GFIFO_STATS_H
+
+/* Per device statistics of the gfifo drivers, updated under dev->mutex and
+ * shown in debugfs <module>/<device>. The helpers also fire the trace events of
+ * gfifo_trace.h, which replace the printk of every read and write.
+ */
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include "gfifo_ring.h"
+#include "gfifo_trace.h"
+
+struct gfifo_stats {
+	u64		reads;		/* read(), readv(), splice from the fifo */
+	u64		read_bytes;
+	u64		writes;
+	u64		write_bytes;
+	u64		eagain;		/* non-blocking accesses of an empty/full fifo */
+	u64		blocks;		/* readers and writers which slept */
+	u64		block_ns;
+	u64		wakeups;	/* wake ups with sleepers */
+	u64		sigio;
+	unsigned int	high_water;	/* highest fill level */
+};
+
+static inline void gfifo_stats_read(struct gfifo_stats *s, unsigned int count, unsigned int len)
+{
+	s->reads++;
+	s->read_bytes += count;
+	trace_gfifo_read(s, count, len);
+}
+
+static inline void gfifo_stats_write(struct gfifo_stats *s, unsigned int count, unsigned int len)
+{
+	s->writes++;
+	s->write_bytes += count;
+	if (len > s->high_water)
+		s->high_water = len;
+	trace_gfifo_write(s, count, len);
+}
+
+/* 'start' is the ktime_get_ns() before the sleep */
+static inline void gfifo_stats_block(struct gfifo_stats *s, bool write, u64 start)
+{
+	u64 ns = ktime_get_ns() - start;
+
+	s->blocks++;
+	s->block_ns += ns;
+	trace_gfifo_block(s, write, ns);
+}
+
+static inline void gfifo_wake_up(struct gfifo_stats *s, wait_queue_head_t *q)
+{
+	if (wq_has_sleeper(q)) {
+		s->wakeups++;
+		wake_up_interruptible(q);
+	}
+}
+
+static inline void gfifo_kill_fasync(struct gfifo_stats *s, struct fasync_struct **fa, int band)
+{
+	if (*fa) {
+		s->sigio++;
+		trace_gfifo_sigio(s, band);
+		kill_fasync(fa, SIGIO, band);
+	}
+}
+
+/* Broadcast readers: lag is the number of bytes not read yet */
+static inline void gfifo_stats_print_readers(struct seq_file *m, const struct gfifo_ring *ring)
+{
+	const struct gfifo_reader *r;
+
+	seq_printf(m, "broadcast:   %s\n", ring->bcast == GFIFO_BCAST_BLOCK ? "block" : "overrun");
+	list_for_each_entry(r, &ring->readers, node)
+		seq_printf(m, "reader %d: lag %u overruns %llu%s\n", r->pid, gfifo_ring_reader_lag(ring, r),
+			r->overruns, gfifo_ring_reader_overrun(ring, r) ? " (overrun)" : "");
+}
+
+static inline void gfifo_stats_print(struct seq_file *m, const struct gfifo_stats *s,
+	const struct gfifo_ring *ring)
+{
+	seq_printf(m, "reads:       %llu\n", s->reads);
+	seq_printf(m, "read_bytes:  %llu\n", s->read_bytes);
+	seq_printf(m, "writes:      %llu\n", s->writes);
+	seq_printf(m, "write_bytes: %llu\n", s->write_bytes);
+	seq_printf(m, "eagain:      %llu\n", s->eagain);
+	seq_printf(m, "blocks:      %llu\n", s->blocks);
+	seq_printf(m, "block_ns:    %llu\n", s->block_ns);
+	seq_printf(m, "wakeups:     %llu\n", s->wakeups);
+	seq_printf(m, "sigio:       %llu\n", s->sigio);
+	seq_printf(m, "high_water:  %u\n", s->high_water);
+	seq_printf(m, "len:         %u\n", gfifo_ring_len(ring));
+	seq_printf(m, "size:        %u\n", ring->size);
+	if (ring->bcast)
+		gfifo_stats_print_readers(m, ring);
+}
+
+/* The debugfs directory is named after the module, so that the gfifo modules
+ * can be loaded together, and shared by its devices. Debugfs errors are not
+ * fatal.
+ */
+static struct dentry *gfifo_debugfs_dir;
+static unsigned int gfifo_debugfs_users;
+
+static inline struct dentry *gfifo_stats_debugfs_create(const char *name, void *data,
+	const struct file_operations *fops)
+{
+	if (gfifo_debugfs_users++ == 0)
+		gfifo_debugfs_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	return debugfs_create_file(name, 0400, gfifo_debugfs_dir, data, fops);
+}
+
+static inline void gfifo_stats_debugfs_remove(struct dentry *file)
+{
+	debugfs_remove(file);
+	if (--gfifo_debugfs_users == 0)
+		debugfs_remove(gfifo_debugfs_dir);
+}
+
+#endif
@@ -0,0 +1,98 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+/* Trace events of the gfifo drivers (events/<module>/ in tracefs). 'fifo'
+ * identifies the device, it is the address of its statistics.
+ * Each driver defines GFIFO_TRACE_SYSTEM, its module name, and
+ * CREATE_TRACE_POINTS before including this header once: the events are
+ * created by every module, which would collide in a shared system.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM GFIFO_TRACE_SYSTEM
+
+#if !defined(KERNEL_GFIFO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define KERNEL_GFIFO_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/signal.h>
+
+DECLARE_EVENT_CLASS(gfifo_xfer,
+	TP_PROTO(const void *fifo, unsigned int count, unsigned int len),
+	TP_ARGS(fifo, count, len),
+	TP_STRUCT__entry(
+		__field(const void *,	fifo)
+		__field(unsigned int,	count)
+		__field(unsigned int,	len)
+	),
+	TP_fast_assign(
+		__entry->fifo = fifo;
+		__entry->count = count;
+		__entry->len = len;
+	),
+	TP_printk("fifo=%p count=%u len=%u", __entry->fifo, __entry->count, __entry->len)
+);
+
+/* 'len' is the fill level after the transfer */
+DEFINE_EVENT(gfifo_xfer, gfifo_read,
+	TP_PROTO(const void *fifo, unsigned int count, unsigned int len),
+	TP_ARGS(fifo, count, len)
+);
+
+DEFINE_EVENT(gfifo_xfer, gfifo_write,
+	TP_PROTO(const void *fifo, unsigned int count, unsigned int len),
+	TP_ARGS(fifo, count, len)
+);
+
+/* A reader (empty fifo) or writer (full fifo) slept 'ns' */
+TRACE_EVENT(gfifo_block,
+	TP_PROTO(const void *fifo, bool write, u64 ns),
+	TP_ARGS(fifo, write, ns),
+	TP_STRUCT__entry(
+		__field(const void *,	fifo)
+		__field(bool,		write)
+		__field(u64,		ns)
+	),
+	TP_fast_assign(
+		__entry->fifo = fifo;
+		__entry->write = write;
+		__entry->ns = ns;
+	),
+	TP_printk("fifo=%p %s ns=%llu", __entry->fifo, __entry->write ? "writer" : "reader",
+		(unsigned long long)__entry->ns)
+);
+
+TRACE_EVENT(gfifo_sigio,
+	TP_PROTO(const void *fifo, int band),
+	TP_ARGS(fifo, band),
+	TP_STRUCT__entry(
+		__field(const void *,	fifo)
+		__field(int,		band)
+	),
+	TP_fast_assign(
+		__entry->fifo = fifo;
+		__entry->band = band;
+	),
+	TP_printk("fifo=%p %s", __entry->fifo, __entry->band == POLL_IN ? "POLL_IN" : "POLL_OUT")
+);
+
+#endif
+
+/* Out of tree: found through the include path of the generic directory */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gfifo_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GFIFO_WATERMARK_H
+#define GFIFO_WATERMARK_H
+
+/* Wake up thresholds of gfifo_async, shared with userspace
+ * (test_suite/gfifo_watermark.c).
+ *
+ * ioctl MEM_WATERMARK (0x7) sets them for the calling file, all zero (wake up
+ * on every byte, every SIGIO at once) until then. The device uses the most
+ * eager setting of its open files: rx_* of the files open for reading, tx_* of
+ * those open for writing, sigio_usecs of those with O_ASYNC.
+ *
+ * Readers (read, poll, SIGIO POLL_IN) are woken once rx_bytes are in the fifo,
+ * or rx_usecs after the oldest unread byte was written (0: no time limit).
+ * The bytes left by a partial read count as written by the last write.
+ * Writers (write, poll, SIGIO POLL_OUT) are woken once tx_bytes are free.
+ * rx_bytes and tx_bytes are clamped to 1..the fifo size. SIGIO, including
+ * the one of rx_usecs, is sent at most once per sigio_usecs, the signals in
+ * between are merged into one at the end of the interval.
+ *
+ * A read() or write() which does not need to sleep is not delayed.
+ */
+#include <linux/types.h>
+
+struct gfifo_watermark {
+	__u32	rx_bytes;
+	__u32	rx_usecs;
+	__u32	tx_bytes;
+	__u32	sigio_usecs;
+};
+
+#endif
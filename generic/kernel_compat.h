@@ -56,4 +56,30 @@
 
 #endif /* 2.6.36 */
 
+/******************************************************************************/
+/* Kernel < 6.5 splices a read_iter into a pipe with generic_file_splice_read */
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6,5,0))
+
+#define copy_splice_read	generic_file_splice_read
+
+#else
+
+/* ITER_PIPE is gone, splice reads use an ITER_BVEC like the writes */
+#define iov_iter_is_pipe(i)	false
+
+#endif /* 6.5 */
+
+/******************************************************************************/
+/* Kernel < 4.20 tests the iov_iter type by hand, ITER_PIPE came with 4.9 */
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(4,20,0))
+
+#define iov_iter_is_bvec(i)	(((i)->type & ITER_BVEC) != 0)
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(4,9,0))
+#define iov_iter_is_pipe(i)	false
+#else
+#define iov_iter_is_pipe(i)	(((i)->type & ITER_PIPE) != 0)
+#endif
+
+#endif /* 4.20 */
+
 #endif
@@ -10,197 +10,317 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 #include <linux/sched/signal.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include "gfifo_dev.h"
+#include "gfifo_watermark.h"
+#define GFIFO_TRACE_SYSTEM gfifo_async
+#define CREATE_TRACE_POINTS
+#include "gfifo_trace.h"
 
 #define GFIFO_MAJOR 232
 #define GFIFO_SIZE 0x100
-#define MEM_CLEAR 0x1
+#define MEM_WATERMARK 0x7
+
+/* sigio_pending bits */
+#define GFIFO_SIGIO_IN 0
+#define GFIFO_SIGIO_OUT 1
 
 static int gfifo_major = GFIFO_MAJOR;
 module_param(gfifo_major, int, S_IRUGO);
+static unsigned int fifo_size = GFIFO_SIZE;
+module_param(fifo_size, uint, S_IRUGO);
 
 struct gfifo_dev {
 	struct cdev cdev;
-	unsigned char mem[GFIFO_SIZE];
-	struct mutex mutex;
-	unsigned long cur_len;
-	wait_queue_head_t r_wait;
-	wait_queue_head_t w_wait;
-	struct fasync_struct *async_queue;
+	struct gfifo_core core;
+	struct dentry *debugfs;
+	struct list_head files;
+	struct gfifo_watermark wm;	/* the most eager of the files */
+	u64 rx_start;			/* when the oldest unread byte was written */
+	u64 rx_last;			/* when the newest one was written */
+	unsigned int rx_len;		/* fill level at the last notification */
+	struct hrtimer rx_timer;
+	spinlock_t sigio_lock;		/* sigio_ns and sigio_timer, also taken by rx_timer */
+	u64 sigio_ns;			/* last SIGIO, or the next one if pending */
+	unsigned long sigio_pending;
+	struct hrtimer sigio_timer;
+};
+
+/* Per open file settings, found by the file like the broadcast readers */
+struct gfifo_file {
+	struct list_head node;
+	struct file *filp;
+	struct gfifo_watermark wm;
+	bool async;
 };
 
 struct gfifo_dev *gfifo_devp;
 
-static int gfifo_fasync(int fd, struct file *filp, int mode)
+static struct gfifo_file *gfifo_find_file(struct gfifo_dev *dev, struct file *filp)
 {
-	struct gfifo_dev *dev = filp->private_data;
-	return fasync_helper(fd, filp, mode, &dev->async_queue);
+	struct gfifo_file *f;
+
+	list_for_each_entry(f, &dev->files, node)
+		if (f->filp == filp)
+			return f;
+	return NULL;
 }
 
-static int gfifo_open(struct inode *inode, struct file *filp)
+/* rx_timer fires rx_usecs after rx_start, re-armed whenever either changes */
+static void gfifo_arm_rx_timer(struct gfifo_dev *dev)
 {
-	filp->private_data = gfifo_devp;
-	return 0;
+	if (dev->rx_start && dev->wm.rx_usecs)
+		hrtimer_start(&dev->rx_timer,
+			ns_to_ktime(dev->rx_start + (u64)dev->wm.rx_usecs * NSEC_PER_USEC), HRTIMER_MODE_ABS);
+	else
+		hrtimer_try_to_cancel(&dev->rx_timer);
 }
 
-static int gfifo_release(struct inode *inode, struct file *filp)
+static void gfifo_update_watermark(struct gfifo_dev *dev)
 {
-	gfifo_fasync(-1, filp, 0);
-	return 0;
+	struct gfifo_watermark wm = { .rx_bytes = U32_MAX, .tx_bytes = U32_MAX, .sigio_usecs = U32_MAX };
+	struct gfifo_file *f;
+
+	list_for_each_entry(f, &dev->files, node) {
+		if (f->filp->f_mode & FMODE_READ) {
+			wm.rx_bytes = min(wm.rx_bytes, f->wm.rx_bytes);
+			if (f->wm.rx_usecs && (!wm.rx_usecs || (f->wm.rx_usecs < wm.rx_usecs)))
+				wm.rx_usecs = f->wm.rx_usecs;
+		}
+		if (f->filp->f_mode & FMODE_WRITE)
+			wm.tx_bytes = min(wm.tx_bytes, f->wm.tx_bytes);
+		if (f->async)
+			wm.sigio_usecs = min(wm.sigio_usecs, f->wm.sigio_usecs);
+	}
+	if (wm.sigio_usecs == U32_MAX)
+		wm.sigio_usecs = 0;
+	dev->wm = wm;
+	gfifo_arm_rx_timer(dev);
 }
 
-static long gfifo_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+/* Send the merged SIGIOs, from the timers (not counted in the statistics) */
+static void gfifo_sigio_flush(struct gfifo_dev *dev)
 {
-	struct gfifo_dev *dev = filp->private_data;
-	switch (cmd) {
-	case MEM_CLEAR:
-		mutex_lock(&dev->mutex);
-		memset(dev->mem, 0, GFIFO_SIZE);
-		mutex_unlock(&dev->mutex);
-		printk(KERN_INFO "gfifo is set to 0\n");
-		break;
-	default:
-		return -EINVAL;
+	if (test_and_clear_bit(GFIFO_SIGIO_IN, &dev->sigio_pending)) {
+		trace_gfifo_sigio(&dev->core.stats, POLL_IN);
+		kill_fasync(&dev->core.async_queue, SIGIO, POLL_IN);
+	}
+	if (test_and_clear_bit(GFIFO_SIGIO_OUT, &dev->sigio_pending)) {
+		trace_gfifo_sigio(&dev->core.stats, POLL_OUT);
+		kill_fasync(&dev->core.async_queue, SIGIO, POLL_OUT);
 	}
-	return 0;
 }
 
-static ssize_t gfifo_read(struct file *filp, char *buf, size_t size, loff_t *ppos)
+static enum hrtimer_restart gfifo_sigio_timer_fn(struct hrtimer *timer)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = filp->private_data;
-	DECLARE_WAITQUEUE(wait, current);
-
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->r_wait, &wait);
+	gfifo_sigio_flush(container_of(timer, struct gfifo_dev, sigio_timer));
+	return HRTIMER_NORESTART;
+}
 
-	while (dev->cur_len == 0) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
-		}
-		mutex_lock(&dev->mutex);
+/* SIGIO at most once per sigio_usecs: true if a SIGIO may be sent now, else
+ * sigio_timer sends the pending ones at the end of the interval
+ */
+static bool gfifo_sigio_due(struct gfifo_dev *dev)
+{
+	u64 now, next;
+	unsigned long flags;
+	bool due = false;
+
+	spin_lock_irqsave(&dev->sigio_lock, flags);
+	now = ktime_get_ns();
+	next = dev->sigio_ns + (u64)READ_ONCE(dev->wm.sigio_usecs) * NSEC_PER_USEC;
+	if (now >= next) {
+		dev->sigio_ns = now;
+		due = true;
+	} else if (!hrtimer_is_queued(&dev->sigio_timer)) {
+		dev->sigio_ns = next;
+		hrtimer_start(&dev->sigio_timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
 	}
+	spin_unlock_irqrestore(&dev->sigio_lock, flags);
+	return due;
+}
 
-	if (count > dev->cur_len)
-		count = dev->cur_len;
-
-	if (copy_to_user(buf, dev->mem, count)) {
-		ret = -EFAULT;
-		goto out;
-	}else {
-		memcpy(dev->mem, dev->mem + count, dev->cur_len - count);
-		dev->cur_len -= count;
-		printk (KERN_INFO "read %u bytes, cur_len: %lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->w_wait);
-		if (dev->async_queue) {
-			kill_fasync(&dev->async_queue, SIGIO, POLL_OUT);
-			printk(KERN_DEBUG "%s kill SIGIO\n", __func__);
-		}
-		ret = count;
+static void gfifo_sigio(struct gfifo_dev *dev, int band)
+{
+	int bit = band == POLL_IN ? GFIFO_SIGIO_IN : GFIFO_SIGIO_OUT;
+
+	if (!dev->core.async_queue)
+		return;
+	if (test_and_set_bit(bit, &dev->sigio_pending))
+		return;		/* merged into the pending one */
+	if (!gfifo_sigio_due(dev)) {
+		dev->core.stats.sigio++;
+		return;
 	}
+	if (test_and_clear_bit(bit, &dev->sigio_pending))
+		gfifo_kill_fasync(&dev->core.stats, &dev->core.async_queue, band);
+}
 
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->r_wait, &wait);
-	__set_current_state(TASK_RUNNING);
-	return ret;
+/* rx_usecs after the oldest unread byte was written, whatever the fill level.
+ * The SIGIO goes through the same rate limit as the others.
+ */
+static enum hrtimer_restart gfifo_rx_timer_fn(struct hrtimer *timer)
+{
+	struct gfifo_dev *dev = container_of(timer, struct gfifo_dev, rx_timer);
+
+	wake_up_interruptible(&dev->core.r_wait);
+	set_bit(GFIFO_SIGIO_IN, &dev->sigio_pending);
+	if (gfifo_sigio_due(dev))
+		gfifo_sigio_flush(dev);
+	return HRTIMER_NORESTART;
 }
 
-static ssize_t gfifo_write(struct file *filp, const char *buf, size_t size, loff_t *ppos)
+static bool gfifo_rx_due(struct gfifo_dev *dev)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = filp->private_data;
-	DECLARE_WAITQUEUE(wait, current);
+	if (gfifo_ring_len(&dev->core.ring) >= min(dev->wm.rx_bytes, dev->core.ring.size))
+		return true;
+	return dev->wm.rx_usecs && dev->rx_start &&
+		(ktime_get_ns() - dev->rx_start >= (u64)dev->wm.rx_usecs * NSEC_PER_USEC);
+}
 
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->w_wait, &wait);
+static bool gfifo_tx_due(struct gfifo_dev *dev)
+{
+	return gfifo_ring_avail(&dev->core.ring) >= min(dev->wm.tx_bytes, dev->core.ring.size);
+}
 
-	while (dev->cur_len == GFIFO_SIZE) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
+/* After a write: wake the readers if they are due, else rx_timer will */
+static void gfifo_notify_readers(struct gfifo_core *fifo)
+{
+	struct gfifo_dev *dev = container_of(fifo, struct gfifo_dev, core);
+	unsigned int len = gfifo_ring_len(&dev->core.ring);
+
+	if (len > dev->rx_len) {
+		dev->rx_last = ktime_get_ns();
+		if (!dev->rx_start) {
+			dev->rx_start = dev->rx_last;
+			gfifo_arm_rx_timer(dev);
 		}
-		mutex_lock(&dev->mutex);
 	}
+	dev->rx_len = len;
+	if (gfifo_rx_due(dev)) {
+		gfifo_wake_up(&dev->core.stats, &dev->core.r_wait);
+		gfifo_sigio(dev, POLL_IN);
+	}
+}
 
-	if (count > GFIFO_SIZE - dev->cur_len)
-		count = GFIFO_SIZE - dev->cur_len;
+/* After a read: wake the writers once tx_bytes are free. What a partial read
+ * leaves is dated from the last write, the time of each byte is not kept.
+ */
+static void gfifo_notify_writers(struct gfifo_core *fifo)
+{
+	struct gfifo_dev *dev = container_of(fifo, struct gfifo_dev, core);
+	unsigned int len = gfifo_ring_len(&dev->core.ring);
 
-	if (copy_from_user(dev->mem + dev->cur_len, buf, count)) {
-		ret = -EFAULT;
-		goto out;
+	if (len < dev->rx_len) {
+		dev->rx_start = len ? dev->rx_last : 0;
+		gfifo_arm_rx_timer(dev);
 	}
-	else {
-		dev->cur_len += count;
-		printk(KERN_INFO "write %u bytes, cur_len:%lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->r_wait);
-		if (dev->async_queue) {
-			kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
-			printk(KERN_DEBUG "%s kill SIGIO\n", __func__);
-		}
-		ret = count;
+	dev->rx_len = len;
+	if (gfifo_tx_due(dev)) {
+		gfifo_wake_up(&dev->core.stats, &dev->core.w_wait);
+		gfifo_sigio(dev, POLL_OUT);
 	}
+}
 
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->w_wait, &wait);
-	__set_current_state(TASK_RUNNING);
+static int gfifo_fasync(int fd, struct file *filp, int mode)
+{
+	struct gfifo_dev *dev = filp->private_data;
+	struct gfifo_file *f;
+	int ret = fasync_helper(fd, filp, mode, &dev->core.async_queue);
+
+	mutex_lock(&dev->core.mutex);
+	f = gfifo_find_file(dev, filp);
+	if (f && (ret >= 0)) {
+		f->async = mode;
+		gfifo_update_watermark(dev);
+	}
+	mutex_unlock(&dev->core.mutex);
 	return ret;
 }
 
-static loff_t gfifo_llseek(struct file *filp, loff_t offset, int orig)
+static int gfifo_open(struct inode *inode, struct file *filp)
 {
-	loff_t ret = 0;
-	switch (orig) {
-	case 0:
-		if (offset < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((unsigned int)offset > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos = (unsigned int)offset;
-		ret = filp->f_pos;
-		break;
-	case 1:
-		if ((filp->f_pos + offset) > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((filp->f_pos + offset) < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos += offset;
-		ret = filp->f_pos;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+	struct gfifo_file *f;
+	int ret;
+
+	filp->private_data = gfifo_devp;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+	f->filp = filp;
+
+	ret = gfifo_core_open(&gfifo_devp->core, filp);
+	if (ret) {
+		kfree(f);
+		return ret;
 	}
+	mutex_lock(&gfifo_devp->core.mutex);
+	list_add_tail(&f->node, &gfifo_devp->files);
+	gfifo_update_watermark(gfifo_devp);
+	mutex_unlock(&gfifo_devp->core.mutex);
+	return 0;
+}
 
-	return ret;
+static int gfifo_release(struct inode *inode, struct file *filp)
+{
+	struct gfifo_dev *dev = filp->private_data;
+	struct gfifo_file *f;
+
+	mutex_lock(&dev->core.mutex);
+	f = gfifo_find_file(dev, filp);
+	list_del(&f->node);
+	kfree(f);
+	gfifo_update_watermark(dev);
+	mutex_unlock(&dev->core.mutex);
+	gfifo_core_release(&dev->core, filp);
+	return 0;
+}
+
+/* MEM_WATERMARK, see gfifo_watermark.h */
+static long gfifo_set_watermark(struct file *filp, struct gfifo_dev *dev, void __user *argp)
+{
+	struct gfifo_watermark wm;
+
+	if (copy_from_user(&wm, argp, sizeof(wm)))
+		return -EFAULT;
+
+	mutex_lock(&dev->core.mutex);
+	wm.rx_bytes = clamp(wm.rx_bytes, 1U, dev->core.ring.size);
+	wm.tx_bytes = clamp(wm.tx_bytes, 1U, dev->core.ring.size);
+	gfifo_find_file(dev, filp)->wm = wm;
+	gfifo_update_watermark(dev);
+	/* Lower thresholds may be reached already */
+	gfifo_wake_up(&dev->core.stats, &dev->core.r_wait);
+	gfifo_wake_up(&dev->core.stats, &dev->core.w_wait);
+	mutex_unlock(&dev->core.mutex);
+	return 0;
+}
+
+static long gfifo_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct gfifo_dev *dev = filp->private_data;
+
+	if (cmd == MEM_WATERMARK)
+		return gfifo_set_watermark(filp, dev, (void __user *)arg);
+	return gfifo_core_ioctl(&dev->core, filp, cmd, arg);
+}
+
+static ssize_t gfifo_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct gfifo_dev *dev = iocb->ki_filp->private_data;
+
+	return gfifo_core_read_iter(&dev->core, iocb, to);
+}
+
+static ssize_t gfifo_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct gfifo_dev *dev = iocb->ki_filp->private_data;
+
+	return gfifo_core_write_iter(&dev->core, iocb, from);
 }
 
 static unsigned int gfifo_poll(struct file *filp, poll_table *p) 
@@ -208,26 +328,51 @@ static unsigned int gfifo_poll(struct file *filp, poll_table *p)
 	unsigned int mask = 0;
 	struct gfifo_dev *dev = filp->private_data;	
 
-	mutex_lock(&dev->mutex);
+	mutex_lock(&dev->core.mutex);
 
-	poll_wait(filp, &dev->r_wait, p);
-	poll_wait(filp, &dev->w_wait, p);
+	poll_wait(filp, &dev->core.r_wait, p);
+	poll_wait(filp, &dev->core.w_wait, p);
 
-	if (dev->cur_len != 0)
+	if (gfifo_ring_readable(&dev->core.ring, filp) && gfifo_rx_due(dev))
 		mask |= POLLIN|POLLRDNORM;
-	if (dev->cur_len != GFIFO_SIZE)
+	if (gfifo_ring_writable(&dev->core.ring, 1) && gfifo_tx_due(dev))
 		mask |= POLLOUT|POLLWRNORM;
 
-	mutex_unlock(&dev->mutex);
+	mutex_unlock(&dev->core.mutex);
 	return mask;
 }
 
+static int gfifo_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct gfifo_dev *dev = filp->private_data;
+
+	return gfifo_ring_mmap(&dev->core.ring, vma);
+}
+
+static int gfifo_stats_show(struct seq_file *m, void *v)
+{
+	struct gfifo_dev *dev = m->private;
+
+	mutex_lock(&dev->core.mutex);
+	gfifo_stats_print(m, &dev->core.stats, &dev->core.ring);
+	seq_printf(m, "rx_bytes:    %u\n", dev->wm.rx_bytes);
+	seq_printf(m, "rx_usecs:    %u\n", dev->wm.rx_usecs);
+	seq_printf(m, "tx_bytes:    %u\n", dev->wm.tx_bytes);
+	seq_printf(m, "sigio_usecs: %u\n", dev->wm.sigio_usecs);
+	mutex_unlock(&dev->core.mutex);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(gfifo_stats);
+
 static struct file_operations gfifo_fops = {
 	.owner = THIS_MODULE,
-	.llseek = gfifo_llseek,
-	.read = gfifo_read,
-	.write = gfifo_write,
+	.llseek = noop_llseek,
+	.read_iter = gfifo_read_iter,
+	.write_iter = gfifo_write_iter,
+	.splice_read = copy_splice_read,
+	.splice_write = iter_file_splice_write,
 	.unlocked_ioctl = gfifo_ioctl,
+	.mmap = gfifo_mmap,
 	.poll = gfifo_poll,
 	.fasync = gfifo_fasync,
 	.open = gfifo_open,
@@ -265,13 +410,25 @@ static int __init gfifo_init(void)
 		ret = -ENOMEM;
 		goto fail_malloc;
 	}
-	
-	mutex_init(&gfifo_devp->mutex);
-	init_waitqueue_head(&gfifo_devp->r_wait);
-	init_waitqueue_head(&gfifo_devp->w_wait);
+
+	ret = gfifo_core_init(&gfifo_devp->core, fifo_size);
+	if (ret)
+		goto fail_ring;
+
+	gfifo_devp->core.notify_readers = gfifo_notify_readers;
+	gfifo_devp->core.notify_writers = gfifo_notify_writers;
+	INIT_LIST_HEAD(&gfifo_devp->files);
+	hrtimer_init(&gfifo_devp->rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	spin_lock_init(&gfifo_devp->sigio_lock);
+	gfifo_devp->rx_timer.function = gfifo_rx_timer_fn;
+	hrtimer_init(&gfifo_devp->sigio_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	gfifo_devp->sigio_timer.function = gfifo_sigio_timer_fn;
 
 	gfifo_setup_cdev(gfifo_devp, 0);
+	gfifo_devp->debugfs = gfifo_stats_debugfs_create("gfifo0", gfifo_devp, &gfifo_stats_fops);
 	return 0;
+fail_ring:
+	kfree(gfifo_devp);
 fail_malloc:
 	unregister_chrdev_region(devno, 1);
 	return ret;
@@ -280,8 +437,11 @@ module_init(gfifo_init);
 
 static void __exit gfifo_exit(void)
 {
+	gfifo_stats_debugfs_remove(gfifo_devp->debugfs);
 	cdev_del(&gfifo_devp->cdev);
-	mutex_destroy(&gfifo_devp->mutex);
+	hrtimer_cancel(&gfifo_devp->rx_timer);
+	hrtimer_cancel(&gfifo_devp->sigio_timer);
+	gfifo_core_free(&gfifo_devp->core);
 	kfree(gfifo_devp);
 	unregister_chrdev_region(MKDEV(gfifo_major, 0), 1);
 }
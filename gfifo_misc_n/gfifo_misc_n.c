@@ -9,6 +9,7 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 #include <linux/platform_device.h>
 #include <linux/miscdevice.h>
 #include <linux/version.h>
@@ -17,230 +18,120 @@
 #else
 #include <linux/sched/signal.h>
 #endif
+#include <linux/property.h>
+#include <linux/of.h>
+#include "gfifo_dev.h"
+#define GFIFO_TRACE_SYSTEM gfifo_misc_n
+#define CREATE_TRACE_POINTS
+#include "gfifo_trace.h"
 
 #define GFIFO_SIZE 0x100
-#define MEM_CLEAR 0x1
 #define GFIFO_NAME_SIZE 0x0A
 
+static unsigned int fifo_size = GFIFO_SIZE;
+module_param(fifo_size, uint, S_IRUGO);
+
 struct gfifo_dev {
 	struct cdev cdev;
-	unsigned char mem[GFIFO_SIZE];
-	struct mutex mutex;
-	unsigned long cur_len;
-	wait_queue_head_t r_wait;
-	wait_queue_head_t w_wait;
-	struct fasync_struct *async_queue;
+	struct gfifo_core core;
+	struct dentry *debugfs;
 	struct miscdevice miscdev;
 };
 
-static int gfifo_fasync(int fd, struct file *filp, int mode)
+static struct gfifo_core *gfifo_fifo(struct file *filp)
 {
 	struct gfifo_dev *dev = container_of(filp->private_data, struct gfifo_dev, miscdev);
-	return fasync_helper(fd, filp, mode, &dev->async_queue);
+
+	return &dev->core;
+}
+
+static int gfifo_fasync(int fd, struct file *filp, int mode)
+{
+	return fasync_helper(fd, filp, mode, &gfifo_fifo(filp)->async_queue);
+}
+
+/* misc_open() has set private_data to the miscdevice */
+static int gfifo_open(struct inode *inode, struct file *filp)
+{
+	return gfifo_core_open(gfifo_fifo(filp), filp);
 }
 
 static int gfifo_release(struct inode *inode, struct file *filp)
 {
-	gfifo_fasync(-1, filp, 0);
+	gfifo_core_release(gfifo_fifo(filp), filp);
 	return 0;
 }
 
 static long gfifo_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
-	struct gfifo_dev *dev = container_of(filp->private_data, struct gfifo_dev, miscdev);
-	switch (cmd) {
-	case MEM_CLEAR:
-		mutex_lock(&dev->mutex);
-		memset(dev->mem, 0, GFIFO_SIZE);
-		mutex_unlock(&dev->mutex);
-		break;
-	default:
-		return -EINVAL;
-	}
-	return 0;
+	return gfifo_core_ioctl(gfifo_fifo(filp), filp, cmd, arg);
 }
 
-static ssize_t gfifo_read(struct file *filp, char *buf, size_t size, loff_t *ppos)
+static ssize_t gfifo_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = container_of(filp->private_data, struct gfifo_dev, miscdev);
-	DECLARE_WAITQUEUE(wait, current);
-
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->r_wait, &wait);
-
-	while (dev->cur_len == 0) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
-		}
-		mutex_lock(&dev->mutex);
-	}
-
-	if (count > dev->cur_len)
-		count = dev->cur_len;
-
-	if (copy_to_user(buf, dev->mem, count)) {
-		ret = -EFAULT;
-		goto out;
-	}else {
-		memcpy(dev->mem, dev->mem + count, dev->cur_len - count);
-		dev->cur_len -= count;
-		printk (KERN_INFO "read %u bytes, cur_len: %lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->w_wait);
-		if (dev->async_queue) {
-			kill_fasync(&dev->async_queue, SIGIO, POLL_OUT);
-			printk(KERN_DEBUG "%s kill SIGIO\n", __func__);
-		}
-		ret = count;
-	}
-
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->r_wait, &wait);
-	__set_current_state(TASK_RUNNING);
-	return ret;
+	return gfifo_core_read_iter(gfifo_fifo(iocb->ki_filp), iocb, to);
 }
 
-static ssize_t gfifo_write(struct file *filp, const char *buf, size_t size, loff_t *ppos)
+static ssize_t gfifo_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = container_of(filp->private_data, struct gfifo_dev, miscdev);
-	DECLARE_WAITQUEUE(wait, current);
-
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->w_wait, &wait);
-
-	while (dev->cur_len == GFIFO_SIZE) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
-		}
-		mutex_lock(&dev->mutex);
-	}
-
-	if (count > GFIFO_SIZE - dev->cur_len)
-		count = GFIFO_SIZE - dev->cur_len;
-
-	if (copy_from_user(dev->mem + dev->cur_len, buf, count)) {
-		ret = -EFAULT;
-		goto out;
-	}
-	else {
-		dev->cur_len += count;
-		printk(KERN_INFO "write %u bytes, cur_len:%lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->r_wait);
-		if (dev->async_queue) {
-			kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
-			printk(KERN_DEBUG "%s kill SIGIO\n", __func__);
-		}
-		ret = count;
-	}
-
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->w_wait, &wait);
-	__set_current_state(TASK_RUNNING);
-	return ret;
+	return gfifo_core_write_iter(gfifo_fifo(iocb->ki_filp), iocb, from);
 }
 
-static loff_t gfifo_llseek(struct file *filp, loff_t offset, int orig)
+static unsigned int gfifo_poll(struct file *filp, poll_table *p)
 {
-	loff_t ret = 0;
-	switch (orig) {
-	case 0:
-		if (offset < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((unsigned int)offset > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos = (unsigned int)offset;
-		ret = filp->f_pos;
-		break;
-	case 1:
-		if ((filp->f_pos + offset) > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((filp->f_pos + offset) < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos += offset;
-		ret = filp->f_pos;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-
-	return ret;
+	return gfifo_core_poll(gfifo_fifo(filp), filp, p);
 }
 
-static unsigned int gfifo_poll(struct file *filp, poll_table *p) 
+static int gfifo_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-	unsigned int mask = 0;
-	struct gfifo_dev *dev = container_of(filp->private_data, struct gfifo_dev, miscdev);
-
-	mutex_lock(&dev->mutex);
-
-	poll_wait(filp, &dev->r_wait, p);
-	poll_wait(filp, &dev->w_wait, p);
+	return gfifo_ring_mmap(&gfifo_fifo(filp)->ring, vma);
+}
 
-	if (dev->cur_len != 0)
-		mask |= POLLIN|POLLRDNORM;
-	if (dev->cur_len != GFIFO_SIZE)
-		mask |= POLLOUT|POLLWRNORM;
+static int gfifo_stats_show(struct seq_file *m, void *v)
+{
+	struct gfifo_dev *dev = m->private;
 
-	mutex_unlock(&dev->mutex);
-	return mask;
+	mutex_lock(&dev->core.mutex);
+	gfifo_stats_print(m, &dev->core.stats, &dev->core.ring);
+	mutex_unlock(&dev->core.mutex);
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(gfifo_stats);
 
 static struct file_operations gfifo_fops = {
 	.owner = THIS_MODULE,
-	.llseek = gfifo_llseek,
-	.read = gfifo_read,
-	.write = gfifo_write,
+	.llseek = noop_llseek,
+	.read_iter = gfifo_read_iter,
+	.write_iter = gfifo_write_iter,
+	.splice_read = copy_splice_read,
+	.splice_write = iter_file_splice_write,
 	.unlocked_ioctl = gfifo_ioctl,
+	.mmap = gfifo_mmap,
 	.poll = gfifo_poll,
 	.fasync = gfifo_fasync,
+	.open = gfifo_open,
 	.release = gfifo_release,
 };
 
 static int gfifo_probe(struct platform_device *pdev)
 {
 	int ret;
+	u32 size = fifo_size;
 	struct gfifo_dev *dev;
 	char dev_name[GFIFO_NAME_SIZE];
 
+	/* The "fifo-size" property of the device overrides the module parameter */
+	device_property_read_u32(&pdev->dev, "fifo-size", &size);
+
 	dev = kzalloc(sizeof(struct gfifo_dev), GFP_KERNEL);
 	if (!dev)
 		return -ENOMEM;
 
-	mutex_init(&dev->mutex);
-	init_waitqueue_head(&dev->r_wait);
-	init_waitqueue_head(&dev->w_wait);
+	ret = gfifo_core_init(&dev->core, size);
+	if (ret) {
+		kfree(dev);
+		return ret;
+	}
 
 	snprintf(dev_name, sizeof(dev_name), "gfifo%d", pdev->id);
 
@@ -252,9 +143,12 @@ static int gfifo_probe(struct platform_device *pdev)
 	ret = misc_register(&dev->miscdev);
 	if (ret) {
 		printk(KERN_ERR "%s: register misc device failed\n", __func__);
+		gfifo_core_free(&dev->core);
+		kfree(dev);
 		return ret;
 	}
 
+	dev->debugfs = gfifo_stats_debugfs_create(dev_name, dev, &gfifo_stats_fops);
 	return 0;
 }
 
@@ -262,16 +156,24 @@ static int gfifo_remove(struct platform_device *pdev)
 {
 	struct gfifo_dev *dev = platform_get_drvdata(pdev);
 
+	gfifo_stats_debugfs_remove(dev->debugfs);
 	misc_deregister(&dev->miscdev);
-	mutex_destroy(&dev->mutex);
+	gfifo_core_free(&dev->core);
 	kfree(dev);
 	return 0;
 }
 
+static const struct of_device_id gfifo_of_match[] = {
+	{ .compatible = "babytech,gfifo" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, gfifo_of_match);
+
 static struct platform_driver gfifo_driver = {
 	.driver = {
 		.name = "gfifo",
 		.owner = THIS_MODULE,
+		.of_match_table = gfifo_of_match,
 	},
 	.probe = gfifo_probe,
 	.remove = gfifo_remove,
@@ -10,220 +10,93 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 #include <linux/sched/signal.h>
+#include "gfifo_dev.h"
+#define GFIFO_TRACE_SYSTEM gfifo_nonblock
+#define CREATE_TRACE_POINTS
+#include "gfifo_trace.h"
 
 #define GFIFO_MAJOR 232
 #define GFIFO_SIZE 0x100
-#define MEM_CLEAR 0x1
 
 static int gfifo_major = GFIFO_MAJOR;
 module_param(gfifo_major, int, S_IRUGO);
+static unsigned int fifo_size = GFIFO_SIZE;
+module_param(fifo_size, uint, S_IRUGO);
 
 struct gfifo_dev {
 	struct cdev cdev;
-	unsigned char mem[GFIFO_SIZE];
-	struct mutex mutex;
-	unsigned long cur_len;
-	wait_queue_head_t r_wait;
-	wait_queue_head_t w_wait;
+	struct gfifo_core core;
+	struct dentry *debugfs;
 };
 
 struct gfifo_dev *gfifo_devp;
 
+static struct gfifo_core *gfifo_fifo(struct file *filp)
+{
+	struct gfifo_dev *dev = filp->private_data;
+
+	return &dev->core;
+}
+
 static int gfifo_open(struct inode *inode, struct file *filp)
 {
 	filp->private_data = gfifo_devp;
-	return 0;
+	return gfifo_core_open(&gfifo_devp->core, filp);
 }
 
 static int gfifo_release(struct inode *inode, struct file *filp)
 {
+	gfifo_core_release(gfifo_fifo(filp), filp);
 	return 0;
 }
 
 static long gfifo_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
-	struct gfifo_dev *dev = filp->private_data;
-	switch (cmd) {
-	case MEM_CLEAR:
-		mutex_lock(&dev->mutex);
-		memset(dev->mem, 0, GFIFO_SIZE);
-		mutex_unlock(&dev->mutex);
-		printk(KERN_INFO "gfifo is set to 0\n");
-		break;
-	default:
-		return -EINVAL;
-	}
-	return 0;
+	return gfifo_core_ioctl(gfifo_fifo(filp), filp, cmd, arg);
 }
 
-static ssize_t gfifo_read(struct file *filp, char *buf, size_t size, loff_t *ppos)
+static ssize_t gfifo_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = filp->private_data;
-	DECLARE_WAITQUEUE(wait, current);
-
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->r_wait, &wait);
-
-	while (dev->cur_len == 0) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
-		}
-		mutex_lock(&dev->mutex);
-	}
-
-/*
-	if (p >= GFIFO_SIZE)
-		return 0;
-	if (count > GFIFO_SIZE - p)
-		count = GFIFO_SIZE - p;
-*/
-	if (count > dev->cur_len)
-		count = dev->cur_len;
-
-	if (copy_to_user(buf, dev->mem, count)) {
-		ret = -EFAULT;
-		goto out;
-	}else {
-		memcpy(dev->mem, dev->mem + count, dev->cur_len - count);
-		dev->cur_len -= count;
-		printk (KERN_INFO "read %u bytes, cur_len: %lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->w_wait);
-		ret = count;
-	}
-
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->r_wait, &wait);
-	__set_current_state(TASK_RUNNING);
-	return ret;
+	return gfifo_core_read_iter(gfifo_fifo(iocb->ki_filp), iocb, to);
 }
 
-static ssize_t gfifo_write(struct file *filp, const char *buf, size_t size, loff_t *ppos)
+static ssize_t gfifo_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
-	unsigned int count = size;
-	size_t ret = 0;
-	struct gfifo_dev *dev = filp->private_data;	
-	DECLARE_WAITQUEUE(wait, current);
-
-	mutex_lock(&dev->mutex);
-	add_wait_queue(&dev->w_wait, &wait);
-
-	while (dev->cur_len == GFIFO_SIZE) {
-		if (filp->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			goto out;
-		}
-		__set_current_state(TASK_INTERRUPTIBLE);
-		mutex_unlock(&dev->mutex);
-		schedule();
-		if (signal_pending(current)) {
-			ret = -ERESTARTSYS;
-			goto out2;
-		}
-		mutex_lock(&dev->mutex);
-	}
-
-/*
-	if (p >= GFIFO_SIZE)
-		return 0;
-	if (count > GFIFO_SIZE - p)
-		count = GFIFO_SIZE - p;
-*/
-	if (count > GFIFO_SIZE - dev->cur_len)
-		count = GFIFO_SIZE - dev->cur_len;
-
-	if (copy_from_user(dev->mem + dev->cur_len, buf, count)) {
-		ret = -EFAULT;
-		goto out;
-	}
-	else {
-		dev->cur_len += count;
-		printk(KERN_INFO "write %u bytes, cur_len:%lu \n", count, dev->cur_len);
-		wake_up_interruptible(&dev->r_wait);
-		ret = count;
-	}
-
-out:
-	mutex_unlock(&dev->mutex);
-out2:
-	remove_wait_queue(&dev->w_wait, &wait);
-	__set_current_state(TASK_RUNNING);
-	return ret;
+	return gfifo_core_write_iter(gfifo_fifo(iocb->ki_filp), iocb, from);
 }
 
-static loff_t gfifo_llseek(struct file *filp, loff_t offset, int orig)
+static unsigned int gfifo_poll(struct file *filp, poll_table *p)
 {
-	loff_t ret = 0;
-	switch (orig) {
-	case 0:
-		if (offset < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((unsigned int)offset > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos = (unsigned int)offset;
-		ret = filp->f_pos;
-		break;
-	case 1:
-		if ((filp->f_pos + offset) > GFIFO_SIZE) {
-			ret = -EINVAL;
-			break;
-		}
-		if ((filp->f_pos + offset) < 0) {
-			ret = -EINVAL;
-			break;
-		}
-		filp->f_pos += offset;
-		ret = filp->f_pos;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-
-	return ret;
+	return gfifo_core_poll(gfifo_fifo(filp), filp, p);
 }
 
-static unsigned int gfifo_poll(struct file *filp, poll_table *p) 
+static int gfifo_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-	unsigned int mask = 0;
-	struct gfifo_dev *dev = filp->private_data;	
-
-	mutex_lock(&dev->mutex);
-
-	poll_wait(filp, &dev->r_wait, p);
-	poll_wait(filp, &dev->w_wait, p);
+	return gfifo_ring_mmap(&gfifo_fifo(filp)->ring, vma);
+}
 
-	if (dev->cur_len != 0)
-		mask |= POLLIN|POLLRDNORM;
-	if (dev->cur_len != GFIFO_SIZE)
-		mask |= POLLOUT|POLLWRNORM;
+static int gfifo_stats_show(struct seq_file *m, void *v)
+{
+	struct gfifo_dev *dev = m->private;
 
-	mutex_unlock(&dev->mutex);
-	return mask;
+	mutex_lock(&dev->core.mutex);
+	gfifo_stats_print(m, &dev->core.stats, &dev->core.ring);
+	mutex_unlock(&dev->core.mutex);
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(gfifo_stats);
 
 static struct file_operations gfifo_fops = {
 	.owner = THIS_MODULE,
-	.llseek = gfifo_llseek,
-	.read = gfifo_read,
-	.write = gfifo_write,
+	.llseek = noop_llseek,
+	.read_iter = gfifo_read_iter,
+	.write_iter = gfifo_write_iter,
+	.splice_read = copy_splice_read,
+	.splice_write = iter_file_splice_write,
 	.unlocked_ioctl = gfifo_ioctl,
+	.mmap = gfifo_mmap,
 	.poll = gfifo_poll,
 	.open = gfifo_open,
 	.release = gfifo_release,
@@ -260,13 +133,16 @@ static int __init gfifo_init(void)
 		ret = -ENOMEM;
 		goto fail_malloc;
 	}
-	
-	mutex_init(&gfifo_devp->mutex);
-	init_waitqueue_head(&gfifo_devp->r_wait);
-	init_waitqueue_head(&gfifo_devp->w_wait);
+
+	ret = gfifo_core_init(&gfifo_devp->core, fifo_size);
+	if (ret)
+		goto fail_ring;
 
 	gfifo_setup_cdev(gfifo_devp, 0);
+	gfifo_devp->debugfs = gfifo_stats_debugfs_create("gfifo0", gfifo_devp, &gfifo_stats_fops);
 	return 0;
+fail_ring:
+	kfree(gfifo_devp);
 fail_malloc:
 	unregister_chrdev_region(devno, 1);
 	return ret;
@@ -275,8 +151,9 @@ module_init(gfifo_init);
 
 static void __exit gfifo_exit(void)
 {
+	gfifo_stats_debugfs_remove(gfifo_devp->debugfs);
 	cdev_del(&gfifo_devp->cdev);
-	mutex_destroy(&gfifo_devp->mutex);
+	gfifo_core_free(&gfifo_devp->core);
 	kfree(gfifo_devp);
 	unregister_chrdev_region(MKDEV(gfifo_major, 0), 1);
 }
@@ -38,7 +38,7 @@ static enum led_brightness _dev_leds_brightness_get(struct led_classdev *cdev)
 
 /*		dev_dbg(cdev->dev, "Read LED status for '%s'\n", cdev->name);*/
 
-		reg = dev_read(addr) & led->reg_mask;
+		reg = dev_read_status(addr) & led->reg_mask;
 	}
 
 	if ( (reg && led->active_low) || (!reg && !led->active_low)) {
@@ -49,6 +49,16 @@ static enum led_brightness _dev_leds_brightness_get(struct led_classdev *cdev)
 	return ret;
 }
 
+static u8 dev_led_reg_value(struct dev_led *led, enum led_brightness led_value)
+{
+	if ((led_value && led->active_low) || (!led_value && !led->active_low)) {
+		/* (ON && active low) || (OFF && active high) */
+		return 0;
+	}
+	/* (OFF && active low) || (ON && ACTIVE_HIGH) */
+	return led->reg_mask;
+}
+
 static void _dev_leds_brightness_set(struct led_classdev *cdev,
 		enum led_brightness led_value)
 {
@@ -59,13 +69,7 @@ static void _dev_leds_brightness_set(struct led_classdev *cdev,
 
 /*		dev_dbg(cdev->dev, "Write LED status %d for '%s'\n", (int)led_value, cdev->name);*/
 
-		if ((led_value && led->active_low) || (!led_value && !led->active_low)) {
-			/* (ON && active low) || (OFF && active high) */
-			dev_read_modify_write(addr, led->reg_mask, 0);
-		} else {
-			/* (OFF && active low) || (ON && ACTIVE_HIGH) */
-			dev_read_modify_write(addr, led->reg_mask, led->reg_mask);
-		}
+		dev_read_modify_write(addr, led->reg_mask, dev_led_reg_value(led, led_value));
 	}
 }
 static void dev_leds_enb_reg_set(struct led_classdev *cdev)
@@ -111,6 +115,55 @@ void dev_led_set_work(struct work_struct *work)
 }
 EXPORT_SYMBOL_GPL(dev_led_set_work);
 
+/* LEDs whose brightness_set is not ours are initialized through it once
+ * registered, it may need the class device
+ */
+static int dev_leds_custom_set(struct dev_led *led)
+{
+	return (led->cdev.brightness_set != _dev_leds_brightness_set) &&
+	       (led->cdev.brightness_set != dev_leds_brightness_set);
+}
+
+/* Write the initial brightness and enable registers of the LEDs, before they
+ * are registered so that a trigger or userspace never sees them uninitialized.
+ * The LEDs usually share a few registers, so the read/modify/writes are
+ * done in one batch (one lock acquisition) instead of one per register.
+ */
+static void dev_leds_init_regs(struct dev_led dev_leds[], int num_dev_leds)
+{
+	struct ga_reg_op *ops;
+	int i, count = 0;
+
+	ops = kcalloc(num_dev_leds * 2, sizeof(*ops), GFP_KERNEL);
+
+	for (i = 0; i < num_dev_leds; i++) {
+		struct dev_led *led = &dev_leds[i];
+
+		if (dev_leds_custom_set(led))
+			continue;
+
+		/* Allocation failures go the slow way, without the workqueue */
+		if (ops == NULL) {
+			_dev_leds_brightness_set(&led->cdev, led->cdev.brightness);
+			dev_leds_enb_reg_set(&led->cdev);
+			continue;
+		}
+
+		if (led->disabled)
+			continue;
+
+		ops[count++] = (struct ga_reg_op)DEV_OP_READ_MODIFY_WRITE(led->reg_base + led->reg_offset,
+			led->reg_mask, dev_led_reg_value(led, led->cdev.brightness));
+		if (led->enb_ctrl)
+			ops[count++] = (struct ga_reg_op)DEV_OP_READ_MODIFY_WRITE(led->reg_base + led->enb_reg_offset,
+				led->enb_reg_mask, led->enb_reg_value);
+	}
+
+	if (count > 0)
+		dev_batch(ops, count);
+	kfree(ops);
+}
+
 int dev_leds_init(struct platform_device *pdev, void __iomem *dev_base,
 	struct dev_led dev_leds[], int num_dev_leds)
 {
@@ -126,7 +179,11 @@ int dev_leds_init(struct platform_device *pdev, void __iomem *dev_base,
 		dev_leds[i].led_brightness_set ? dev_leds[i].led_brightness_set : _dev_leds_brightness_set;
 		dev_leds[i].cdev.flags |= LED_CORE_SUSPENDRESUME;
 		dev_leds[i].reg_base = dev_base;
+	}
 
+	dev_leds_init_regs(dev_leds, num_dev_leds);
+
+	for (i = 0; i < num_dev_leds; i++) {
 		/* back up initial_brighness, it might be overwritten during registration */
 		initial_brightness = dev_leds[i].cdev.brightness;
 		ret = led_classdev_register(&pdev->dev, &dev_leds[i].cdev);
@@ -134,8 +191,10 @@ int dev_leds_init(struct platform_device *pdev, void __iomem *dev_base,
 			goto fail;
 
 		dev_leds[i].cdev.brightness = initial_brightness;
-		dev_leds[i].cdev.brightness_set(&dev_leds[i].cdev, dev_leds[i].cdev.brightness);
-		dev_leds_enb_reg_set(&dev_leds[i].cdev);
+		if (dev_leds_custom_set(&dev_leds[i])) {
+			dev_leds[i].cdev.brightness_set(&dev_leds[i].cdev, initial_brightness);
+			dev_leds_enb_reg_set(&dev_leds[i].cdev);
+		}
 	}
 
 	return ret;
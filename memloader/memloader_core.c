@@ -15,7 +15,7 @@
  *
 *******************************************************************************/
 
-#define DRIVER_VERSION      "0.0.4"
+#define DRIVER_VERSION      "0.0.5"
 
 #include <linux/module.h>		/* Needed by all modules */
 #include <linux/version.h>
@@ -25,6 +25,7 @@
 #include <asm/io.h>
 #include "kernel_compat.h"
 #include "firmware.h"
+#include "generic_access.h"
 
 struct memloader_info {
 	struct kobject kobj;
@@ -55,7 +56,8 @@ static int memloader_load(__be64 phy_address, const unsigned char *data, int cou
 	if (!base)
 		return -EBUSY;
 
-	memcpy(base, data, count);
+	/* Widest accesses, under the generic_access lock */
+	ga_memcpy_toio(base, data, count);
 	iounmap(base);
 
 	return count;
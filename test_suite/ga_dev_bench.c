@@ -0,0 +1,172 @@
+/*
+ * ga_dev_bench - compare register reads through /dev/mem and /dev/ga
+ *
+ * Usage: ga_dev_bench <physical address> [accesses] [batch]
+ *
+ * The 32-bit register at <physical address> is read <accesses> times:
+ *  - devmem:  open/mmap/read/munmap/close of /dev/mem per access (devmem2)
+ *  - mmap:    one mapping of /dev/mem, no locking at all
+ *  - ga:      /dev/ga, one GA_IOC_BATCH per access
+ *  - ga bulk: /dev/ga, <batch> accesses per GA_IOC_BATCH
+ * Pick a register whose read has no side effects.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include "ga_ioctl.h"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, long accesses, double elapsed)
+{
+	printf("%-8s %10.0f accesses/s (%ld in %.3f s)\n", name, accesses / elapsed, accesses, elapsed);
+}
+
+static int bench_devmem(off_t addr, long accesses)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	off_t base = addr & ~(off_t)(page - 1);
+	double start = now();
+	long i;
+
+	for (i = 0; i < accesses; i++) {
+		int fd = open("/dev/mem", O_RDWR | O_SYNC);
+		void *map;
+
+		if (fd < 0) {
+			perror("open /dev/mem");
+			return -1;
+		}
+		map = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+		if (map == MAP_FAILED) {
+			perror("mmap /dev/mem");
+			close(fd);
+			return -1;
+		}
+		(void)*(volatile uint32_t *)((char *)map + (addr - base));
+		munmap(map, page);
+		close(fd);
+	}
+	report("devmem", accesses, now() - start);
+	return 0;
+}
+
+static int bench_mmap(off_t addr, long accesses)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	off_t base = addr & ~(off_t)(page - 1);
+	double start;
+	void *map;
+	long i;
+	int fd;
+
+	fd = open("/dev/mem", O_RDWR | O_SYNC);
+	if (fd < 0) {
+		perror("open /dev/mem");
+		return -1;
+	}
+	map = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+	if (map == MAP_FAILED) {
+		perror("mmap /dev/mem");
+		close(fd);
+		return -1;
+	}
+
+	start = now();
+	for (i = 0; i < accesses; i++)
+		(void)*(volatile uint32_t *)((char *)map + (addr - base));
+	report("mmap", accesses, now() - start);
+
+	munmap(map, page);
+	close(fd);
+	return 0;
+}
+
+static int bench_ga(const char *name, off_t addr, long accesses, int batch)
+{
+	struct ga_ioc_op ops[GA_IOC_MAX_OPS];
+	struct ga_ioc_region region;
+	struct ga_ioc_batch b;
+	double start;
+	long done;
+	int fd, i;
+
+	fd = open("/dev/ga", O_RDWR);
+	if (fd < 0) {
+		perror("open /dev/ga");
+		return -1;
+	}
+
+	memset(&region, 0, sizeof(region));
+	region.addr = addr;
+	region.size = 4;
+	if (ioctl(fd, GA_IOC_MAP, &region) < 0) {
+		perror("GA_IOC_MAP");
+		close(fd);
+		return -1;
+	}
+
+	memset(ops, 0, sizeof(ops));
+	for (i = 0; i < batch; i++) {
+		ops[i].region = region.id;
+		ops[i].size = 32;
+		ops[i].op = GA_IOC_OP_READ;
+		ops[i].mask = 0xffffffff;
+	}
+	memset(&b, 0, sizeof(b));
+	b.ops = (uintptr_t)ops;
+
+	start = now();
+	for (done = 0; done < accesses; done += b.count) {
+		b.count = (accesses - done < batch) ? accesses - done : batch;
+		if (ioctl(fd, GA_IOC_BATCH, &b) < 0) {
+			perror("GA_IOC_BATCH");
+			close(fd);
+			return -1;
+		}
+	}
+	report(name, accesses, now() - start);
+
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	off_t addr;
+	long accesses = 100000;
+	int batch = GA_IOC_MAX_OPS;
+
+	if (argc < 2) {
+		printf("Usage: %s <physical address> [accesses] [batch]\n", argv[0]);
+		return 1;
+	}
+	addr = strtoull(argv[1], NULL, 0);
+	if (argc > 2)
+		accesses = strtol(argv[2], NULL, 0);
+	if (argc > 3)
+		batch = atoi(argv[3]);
+	if ((addr & 3) || (accesses <= 0) || (batch <= 0) || (batch > GA_IOC_MAX_OPS)) {
+		printf("Invalid arguments (aligned address, 1 <= batch <= %d)\n", GA_IOC_MAX_OPS);
+		return 1;
+	}
+
+	bench_devmem(addr, accesses);
+	bench_mmap(addr, accesses);
+	bench_ga("ga", addr, accesses, 1);
+	bench_ga("ga bulk", addr, accesses, batch);
+	return 0;
+}
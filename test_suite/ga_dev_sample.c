@@ -0,0 +1,126 @@
+/*
+ * ga_dev_sample - periodic register sampling through /dev/ga
+ *
+ * Usage: ga_dev_sample [-p period_us] [-n samples] [-r rows] <physical address> <offset>...
+ *
+ * The 32-bit registers at <physical address> + <offset> are read by the kernel
+ * every <period_us> (GA_IOC_SAMPLE_START), all in one lock hold, and <samples>
+ * rows are printed as: <time in s> <sequence> <values>. Dropped samples (the
+ * ring of <rows> was full) are reported. Pick registers whose read has no side
+ * effects, e.g. counters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include "ga_ioctl.h"
+
+int main(int argc, char *argv[])
+{
+	struct ga_ioc_op ops[GA_IOC_MAX_OPS];
+	struct ga_ioc_region region;
+	struct ga_ioc_sample smp;
+	unsigned long period_us = 1000;
+	unsigned int rows = 4096;
+	long samples = 1000, done = 0, dropped = 0;
+	uint32_t max_offset = 0;
+	int count, row_size, fd, c, i;
+	uint64_t *buf, next = 0;
+
+	while ((c = getopt(argc, argv, "p:n:r:")) != -1) {
+		switch (c) {
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			samples = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			rows = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	count = argc - optind - 1;
+	if ((count <= 0) || (count > GA_IOC_MAX_OPS) || (samples <= 0) || (rows == 0))
+		goto usage;
+
+	memset(ops, 0, sizeof(ops));
+	for (i = 0; i < count; i++) {
+		ops[i].offset = strtoul(argv[optind + 1 + i], NULL, 0);
+		ops[i].size = 32;
+		ops[i].op = GA_IOC_OP_READ;
+		ops[i].mask = 0xffffffff;
+		if (ops[i].offset & 3)
+			goto usage;
+		if (ops[i].offset > max_offset)
+			max_offset = ops[i].offset;
+	}
+
+	fd = open("/dev/ga", O_RDONLY);
+	if (fd < 0) {
+		perror("open /dev/ga");
+		return 1;
+	}
+
+	memset(&region, 0, sizeof(region));
+	region.addr = strtoull(argv[optind], NULL, 0);
+	region.size = max_offset + 4;
+	if (ioctl(fd, GA_IOC_MAP, &region) < 0) {
+		perror("GA_IOC_MAP");
+		return 1;
+	}
+	for (i = 0; i < count; i++)
+		ops[i].region = region.id;
+
+	memset(&smp, 0, sizeof(smp));
+	smp.ops = (uintptr_t)ops;
+	smp.count = count;
+	smp.rows = rows;
+	smp.period_ns = (uint64_t)period_us * 1000;
+	if (ioctl(fd, GA_IOC_SAMPLE_START, &smp) < 0) {
+		perror("GA_IOC_SAMPLE_START");
+		return 1;
+	}
+
+	row_size = 2 + count;
+	buf = malloc(rows * row_size * sizeof(*buf));
+	if (buf == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	while (done < samples) {
+		ssize_t n = read(fd, buf, rows * row_size * sizeof(*buf));
+		uint64_t *row;
+
+		if (n <= 0) {
+			perror("read");
+			break;
+		}
+		for (row = buf; (row < buf + n / sizeof(*buf)) && (done < samples); row += row_size, done++) {
+			if (row[1] != next)
+				dropped += row[1] - next;
+			next = row[1] + 1;
+			printf("%llu.%09llu %llu", (unsigned long long)(row[0] / 1000000000),
+				(unsigned long long)(row[0] % 1000000000), (unsigned long long)row[1]);
+			for (i = 0; i < count; i++)
+				printf(" %08llx", (unsigned long long)row[2 + i]);
+			printf("\n");
+		}
+	}
+	ioctl(fd, GA_IOC_SAMPLE_STOP);
+	fprintf(stderr, "%ld samples, %ld dropped\n", done, dropped);
+
+	free(buf);
+	close(fd);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-p period_us] [-n samples] [-r rows] <physical address> <offset>...\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,188 @@
+/*
+ * ga_trace_decode - print the register access trace of generic_access
+ *
+ * Usage: ga_trace_decode [-f file] [-n last] [-k]
+ *
+ * The trace (default /sys/kernel/debug/generic_access/trace, or a copy of it)
+ * is mmap'ed, the per cpu rings are merged by timestamp and printed:
+ *   <seconds> <cpu> <type><width> <address> mask <mask> <old> -> <new> <caller>
+ * Start the trace with "echo 1 > /sys/kernel/debug/generic_access/trace_enable"
+ * and stop it (echo 0) before decoding. -n prints the last <last> entries only,
+ * -k resolves the callers with /proc/kallsyms (as root).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "ga_trace.h"
+
+struct ksym {
+	unsigned long long	addr;
+	char			name[128];
+};
+
+static struct ksym *ksyms;
+static size_t ksym_count;
+
+static int ksym_cmp(const void *a, const void *b)
+{
+	const struct ksym *x = a, *y = b;
+
+	return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static void ksyms_load(void)
+{
+	FILE *f = fopen("/proc/kallsyms", "r");
+	size_t size = 0;
+	char line[256];
+
+	if (f == NULL) {
+		perror("/proc/kallsyms");
+		return;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		struct ksym s;
+		char type;
+
+		if (sscanf(line, "%llx %c %127s", &s.addr, &type, s.name) != 3)
+			continue;
+		if ((s.addr == 0) || ((type != 't') && (type != 'T')))
+			continue;
+		if (ksym_count == size) {
+			size = size ? size * 2 : 4096;
+			ksyms = realloc(ksyms, size * sizeof(*ksyms));
+			if (ksyms == NULL) {
+				fprintf(stderr, "Out of memory\n");
+				exit(1);
+			}
+		}
+		ksyms[ksym_count++] = s;
+	}
+	fclose(f);
+	qsort(ksyms, ksym_count, sizeof(*ksyms), ksym_cmp);
+}
+
+static void caller_print(unsigned long long caller)
+{
+	size_t lo = 0, hi = ksym_count;
+
+	/* Last symbol at or before the caller */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (ksyms[mid].addr <= caller)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		printf(" %#llx\n", caller);
+	else
+		printf(" %s+%#llx\n", ksyms[lo - 1].name, caller - ksyms[lo - 1].addr);
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+	const struct ga_trace_entry *x = *(const struct ga_trace_entry * const *)a;
+	const struct ga_trace_entry *y = *(const struct ga_trace_entry * const *)b;
+
+	return (x->timestamp > y->timestamp) - (x->timestamp < y->timestamp);
+}
+
+static void entry_print(const struct ga_trace_entry *e)
+{
+	static const char * const types[] = { "R", "W", "RMW", "RMW-" };
+	const char *type = e->type < sizeof(types) / sizeof(types[0]) ? types[e->type] : "?";
+	int digits = e->width / 4;
+
+	printf("%6llu.%09llu %3u %4s%-2u %#018llx mask %0*llx %0*llx -> %0*llx%s%s",
+		e->timestamp / 1000000000ULL, e->timestamp % 1000000000ULL, e->cpu, type, e->width,
+		e->addr, digits, e->mask, digits, e->old, digits, e->new,
+		(e->flags & GA_TRACE_F_CACHED) ? " cached" : "",
+		(e->flags & GA_TRACE_F_LOCKLESS) ? " lockless" : "");
+	if (ksym_count)
+		caller_print(e->caller);
+	else
+		printf(" %#llx\n", e->caller);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/sys/kernel/debug/generic_access/trace";
+	const struct ga_trace_entry **entries;
+	struct ga_trace_header header;
+	unsigned long long last = 0;
+	size_t size, count = 0, i;
+	unsigned int cpu;
+	void *buf;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "f:n:k")) != -1) {
+		switch (c) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'n':
+			last = strtoull(optarg, NULL, 0);
+			break;
+		case 'k':
+			ksyms_load();
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f file] [-n last] [-k]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		fprintf(stderr, "%s: no trace (never enabled?)\n", path);
+		return 1;
+	}
+	if ((header.magic != GA_TRACE_MAGIC) || (header.version != GA_TRACE_VERSION) ||
+	    (header.entry_size != sizeof(struct ga_trace_entry)) || (header.entries == 0) ||
+	    (header.entries & (header.entries - 1))) {
+		fprintf(stderr, "%s: unknown trace format\n", path);
+		return 1;
+	}
+	size = sizeof(header) + (size_t)header.cpus * header.ring_size;
+	buf = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	entries = malloc((size_t)header.cpus * header.entries * sizeof(*entries));
+	if (entries == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (cpu = 0; cpu < header.cpus; cpu++) {
+		const struct ga_trace_ring *ring = (const void *)((char *)buf + sizeof(header) + (size_t)cpu * header.ring_size);
+		const struct ga_trace_entry *ring_entries = (const void *)(ring + 1);
+		unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		unsigned int n = (ring->wraps || (head >= header.entries)) ? header.entries : head;
+		unsigned int j;
+
+		for (j = 0; j < n; j++)
+			entries[count++] = &ring_entries[(head - n + j) & (header.entries - 1)];
+	}
+	qsort(entries, count, sizeof(*entries), entry_cmp);
+
+	i = ((last != 0) && (last < count)) ? count - last : 0;
+	for (; i < count; i++)
+		entry_print(entries[i]);
+
+	free(entries);
+	munmap(buf, size);
+	close(fd);
+	return 0;
+}
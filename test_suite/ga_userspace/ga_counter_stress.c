@@ -0,0 +1,180 @@
+/*
+ * ga_counter_stress - tear test of 64-bit counter reads through generic_access
+ *
+ * A "hardware" thread keeps incrementing a simulated free-running 64-bit
+ * counter, with a step which carries into the high half every few increments.
+ * Reader threads read it with ga_reg_read64 (locked) and ga_reg_read64_counter
+ * (hi-lo-hi), and check every value against the counter before and after the
+ * read: a torn read is outside of that interval, or smaller than the previous
+ * value. ga_reg_read64_counter must never tear, ga_reg_read64 is expected to
+ * tear on 32-bit builds (the hardware does not take the lock).
+ *
+ * Left alone, the counter rarely carries in the few ns between the two 32-bit
+ * reads (never on a single cpu), so every 32-bit read is followed by a tick
+ * (ga_shim_readl_hook): ga_reg_read64 then tears on a good part of the reads,
+ * which shows that the test does see torn values. -n runs without these ticks.
+ *
+ * Usage: ga_counter_stress [-t threads] [-i iterations] [-s step] [-n]
+ * Built with -DGA_SHIM_32BIT on a 64-bit host, the 32-bit code paths are used.
+ * Returns 1 when a read which must not tear did (ga_reg_read64_counter, or
+ * ga_reg_read64 of a 64-bit build), 2 when ga_reg_read64 of a 32-bit build
+ * did not tear with the ticks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ga_shim.h"
+#include "generic_access.h"
+
+struct stress_thread {
+	pthread_t	thread;
+	int		counter_mode;	/* ga_reg_read64_counter */
+	long		torn;
+};
+
+static int iterations = 1000000;
+static u64 step = 0x10000001ULL;	/* carry every 16 increments */
+static u64 *counter;			/* the "register" */
+static volatile int running;
+
+static inline u64 counter_now(void)
+{
+	return __atomic_load_n(counter, __ATOMIC_SEQ_CST);
+}
+
+static void tick(void)
+{
+	__atomic_fetch_add(counter, step, __ATOMIC_SEQ_CST);
+}
+
+static void *ticker_fn(void *data)
+{
+	while (running)
+		tick();
+	return NULL;
+}
+
+static void *reader_fn(void *data)
+{
+	struct stress_thread *t = data;
+	void __iomem *reg = counter;
+	u64 before, val, after, last = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		before = counter_now();
+		val = t->counter_mode ? ga_reg_read64_counter(reg, ~0ULL) : ga_reg_read64(reg, ~0ULL);
+		after = counter_now();
+		if ((val < before) || (val > after) || (val < last)) {
+			if (t->torn++ == 0)
+				printf("  torn read: %016llx not in [%016llx, %016llx]\n", val, before, after);
+		}
+		last = val;
+	}
+	return NULL;
+}
+
+static long stress_run(struct stress_thread *t, int threads, int counter_mode)
+{
+	pthread_t ticker;
+	long torn = 0;
+	int i;
+
+	running = 1;
+	if (pthread_create(&ticker, NULL, ticker_fn, NULL)) {
+		perror("pthread_create");
+		exit(1);
+	}
+	for (i = 0; i < threads; i++) {
+		t[i].counter_mode = counter_mode;
+		t[i].torn = 0;
+		if (pthread_create(&t[i].thread, NULL, reader_fn, &t[i])) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(t[i].thread, NULL);
+		torn += t[i].torn;
+	}
+	running = 0;
+	pthread_join(ticker, NULL);
+
+	printf("%-22s %3d threads: %ld torn reads of %ld\n",
+		counter_mode ? "ga_reg_read64_counter" : "ga_reg_read64", threads, torn, (long)threads * iterations);
+	return torn;
+}
+
+int main(int argc, char *argv[])
+{
+	struct stress_thread *t;
+	int threads = 2, ticks = 1;
+	long torn, locked_torn;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:i:s:n")) != -1) {
+		switch (c) {
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 's':
+			step = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			ticks = 0;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t threads] [-i iterations] [-s step] [-n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ((threads <= 0) || (iterations <= 0) || (step == 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	if (ga_module_init() < 0)
+		return 1;
+
+	t = calloc(threads, sizeof(*t));
+	counter = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+	if ((t == NULL) || (counter == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	*counter = 0xffffff00ULL;
+
+	if (ticks)
+		ga_shim_readl_hook = tick;
+
+#ifdef CONFIG_64BIT
+	printf("64-bit accesses, step %#llx, %d iterations\n", step, iterations);
+#else
+	printf("32-bit accesses, step %#llx, %d iterations%s\n", step, iterations,
+		ticks ? ", a tick between the halves" : "");
+#endif
+	locked_torn = stress_run(t, threads, 0);
+	torn = stress_run(t, threads, 1);
+
+	ga_module_exit();
+	free(counter);
+	free(t);
+	if (torn)
+		return 1;
+#ifdef CONFIG_64BIT
+	if (locked_torn)
+		return 1;
+#else
+	if (ticks && !locked_torn) {
+		printf("ga_reg_read64 never tore: the test does not see torn reads\n");
+		return 2;
+	}
+#endif
+	return 0;
+}
@@ -0,0 +1,566 @@
+/******************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+*******************************************************************************/
+#ifndef GA_SHIM_H
+#define GA_SHIM_H
+
+/* Just enough of the kernel API to build generic/generic_access.c as a
+ * userspace library, so locking changes can be measured without hardware:
+ *  - spinlocks and mutexes are pthread locks, interrupts are not disabled
+ *  - __raw_readX/__raw_writeX access plain (malloc'ed) memory
+ *  - SRCU is a rwlock, the latched rbtree a sorted list
+ *  - per cpu data is shared by all threads (atomic increments)
+ *  - module_init/module_exit become ga_module_init()/ga_module_exit(), module
+ *    parameters are read from the environment (e.g. GA_stats=1)
+ *  - debugfs files are kept in a table, ga_shim_debugfs_show() prints one
+ * Define GA_SHIM_32BIT to build the 32-bit code paths on a 64-bit host.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/******************************************************************************/
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef u8 __u8;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u64 __u64;
+typedef unsigned long phys_addr_t;
+
+#if (UINTPTR_MAX == 0xffffffffffffffffULL) && !defined(GA_SHIM_32BIT)
+#define CONFIG_64BIT			1
+#endif
+#define __LITTLE_ENDIAN			1234
+
+#define __iomem
+#define __force
+#define __user
+#define __init
+#define __exit
+#define noinline			__attribute__((noinline))
+#define ____cacheline_aligned_in_smp	__attribute__((aligned(64)))
+#define container_of(p, t, m)		((t *)((char *)(p) - offsetof(t, m)))
+#define min_t(t, a, b)			((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)			((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define min(a, b)			((a) < (b) ? (a) : (b))
+#define max(a, b)			((a) > (b) ? (a) : (b))
+#define min3(a, b, c)			((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+#define div64_u64(a, b)			((u64)(a) / (u64)(b))
+#define get_unaligned(p)		(((const struct { __typeof__(*(p)) v; } __attribute__((packed)) *)(p))->v)
+#define put_unaligned(x, p)		(((struct { __typeof__(*(p)) v; } __attribute__((packed)) *)(p))->v = (x))
+#define ilog2(n)			(31 - __builtin_clz(n))
+#define BUILD_BUG_ON(c)			((void)sizeof(char[1 - 2 * !!(c)]))
+#define fls64(x)			((x) ? 64 - __builtin_clzll(x) : 0)
+#define READ_ONCE(x)			(*(volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)		(*(volatile __typeof__(x) *)&(x) = (v))
+#define likely(x)			__builtin_expect(!!(x), 1)
+#define unlikely(x)			__builtin_expect(!!(x), 0)
+#define div_u64(a, b)			((u64)(a) / (b))
+#define roundup_pow_of_two(n)		((n) <= 1 ? 1UL : 1UL << (64 - __builtin_clzll((u64)(n) - 1)))
+#define _RET_IP_			((unsigned long)__builtin_return_address(0))
+#define _THIS_IP_			({ __label__ __here; __here: (unsigned long)&&__here; })
+
+/******************************************************************************/
+/* Module */
+#define EXPORT_SYMBOL_GPL(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define MODULE_ALIAS(x)
+#define MODULE_VERSION(x)
+#define MODULE_PARM_DESC(n, d)
+#define THIS_MODULE			NULL
+#define module_refcount(m)		1	/* the bench is the only user */
+#define module_init(f)			int ga_module_init(void) { return f(); }
+#define module_exit(f)			void ga_module_exit(void) { f(); }
+#define MODULE_STATE_GOING		2
+#define NOTIFY_DONE			0x0000
+#define NOTIFY_OK			0x0001
+struct module;
+struct notifier_block { int (*notifier_call)(struct notifier_block *, unsigned long, void *); };
+static inline int register_module_notifier(struct notifier_block *nb) { return 0; }
+static inline int unregister_module_notifier(struct notifier_block *nb) { return 0; }
+static inline bool within_module(unsigned long addr, const struct module *mod) { return false; }
+#define module_param(n, t, p)								\
+	__attribute__((constructor)) static void ga_shim_param_##n(void)		\
+	{										\
+		const char *v = getenv("GA_" #n);					\
+		if (v != NULL)								\
+			n = strtol(v, NULL, 0);						\
+	}
+
+/******************************************************************************/
+/* Memory */
+#define PAGE_SHIFT			12
+#define PAGE_SIZE			(1UL << PAGE_SHIFT)
+#define PAGE_MASK			(~(PAGE_SIZE - 1))
+#define offset_in_page(p)		((unsigned long)(p) & (PAGE_SIZE - 1))
+#define GFP_KERNEL			0
+#define kzalloc(s, f)			calloc(1, s)
+#define kfree(p)			free(p)
+#define vmalloc_user(s)			calloc(1, s)
+#define kvmalloc_array(n, s, f)		calloc(n, s)
+#define kvfree(p)			free(p)
+#define kmemdup(p, s, f)		memcpy(malloc(s), p, s)
+#define copy_to_user(to, from, n)	(memcpy(to, from, n), 0)
+#define vfree(p)			free(p)
+
+/* The "ioremap'ed" registers are plain memory: physical == virtual */
+struct page;
+static inline struct page *vmalloc_to_page(const void *p) { return (struct page *)p; }
+#define page_to_phys(p)			((phys_addr_t)(unsigned long)(p) & PAGE_MASK)
+
+#define __raw_readb(a)			(*(volatile u8 *)(a))
+#define __raw_readw(a)			(*(volatile u16 *)(a))
+/* Called after every 32-bit register read when set: ga_counter_stress uses it
+ * to make the "hardware" tick between the two halves of a 64-bit read
+ */
+__attribute__((weak)) void (*ga_shim_readl_hook)(void);
+#define __raw_readl(a)			({ u32 __v = *(volatile u32 *)(a); if (ga_shim_readl_hook) ga_shim_readl_hook(); __v; })
+#define __raw_readq(a)			(*(volatile u64 *)(a))
+#define __raw_writeb(v, a)		(*(volatile u8 *)(a) = (v))
+#define __raw_writew(v, a)		(*(volatile u16 *)(a) = (v))
+#define __raw_writel(v, a)		(*(volatile u32 *)(a) = (v))
+#define __raw_writeq(v, a)		(*(volatile u64 *)(a) = (v))
+
+static inline unsigned long hash_long(unsigned long val, unsigned int bits)
+{
+	return (unsigned long)((u64)val * 0x61C8864680B583EBULL) >> (64 - bits);
+}
+
+/******************************************************************************/
+/* Bitmaps */
+#define BITS_PER_LONG			(sizeof(long) * 8)
+#define BITS_TO_LONGS(n)		(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(n, bits)		unsigned long n[BITS_TO_LONGS(bits)]
+#define bitmap_zero(b, n)		memset(b, 0, BITS_TO_LONGS(n) * sizeof(long))
+#define __set_bit(nr, b)		((b)[(nr) / BITS_PER_LONG] |= 1UL << ((nr) % BITS_PER_LONG))
+#define test_bit(nr, b)			(((b)[(nr) / BITS_PER_LONG] >> ((nr) % BITS_PER_LONG)) & 1)
+#define for_each_set_bit(i, b, n)	for ((i) = 0; (i) < (int)(n); (i)++) if (test_bit(i, b))
+
+/******************************************************************************/
+/* Locking: no interrupts in userspace */
+#define local_irq_save(f)		((void)(f))
+#define local_irq_restore(f)		((void)(f))
+
+typedef struct { pthread_spinlock_t l; } spinlock_t;
+#define spin_lock_init(s)		pthread_spin_init(&(s)->l, PTHREAD_PROCESS_PRIVATE)
+#define spin_lock(s)			pthread_spin_lock(&(s)->l)
+#define spin_unlock(s)			pthread_spin_unlock(&(s)->l)
+#define spin_lock_irqsave(s, f)		do { (void)(f); pthread_spin_lock(&(s)->l); } while (0)
+#define spin_unlock_irqrestore(s, f)	pthread_spin_unlock(&(s)->l)
+#define DEFINE_SPINLOCK(n)								\
+	spinlock_t n;									\
+	__attribute__((constructor)) static void ga_shim_spinlock_##n(void)		\
+	{										\
+		spin_lock_init(&n);							\
+	}
+
+struct mutex { pthread_mutex_t m; };
+#define DEFINE_MUTEX(n)			struct mutex n = { PTHREAD_MUTEX_INITIALIZER }
+#define mutex_init(x)			pthread_mutex_init(&(x)->m, NULL)
+#define mutex_lock(x)			pthread_mutex_lock(&(x)->m)
+#define mutex_unlock(x)			pthread_mutex_unlock(&(x)->m)
+#define mutex_trylock(x)		(pthread_mutex_trylock(&(x)->m) == 0)
+#define mutex_lock_interruptible(x)	(pthread_mutex_lock(&(x)->m), 0)
+
+struct lock_class_key { int dummy; };
+#define lockdep_set_class(l, k)		((void)(l), (void)(k))
+
+typedef struct { unsigned int sequence; } seqcount_t;
+#define seqcount_init(s)		((s)->sequence = 0)
+
+static inline unsigned int read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned int seq;
+
+	while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return seq;
+}
+
+static inline int read_seqcount_retry(const seqcount_t *s, unsigned int seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != seq;
+}
+
+static inline void write_seqcount_begin(seqcount_t *s)
+{
+	__atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqcount_end(seqcount_t *s)
+{
+	__atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/* SRCU: readers hold a rwlock, synchronize_srcu waits for them */
+struct srcu_struct { pthread_rwlock_t rw; };
+#define DEFINE_STATIC_SRCU(n)		static struct srcu_struct n = { PTHREAD_RWLOCK_INITIALIZER }
+
+static inline int srcu_read_lock(struct srcu_struct *s)
+{
+	pthread_rwlock_rdlock(&s->rw);
+	return 0;
+}
+
+static inline void srcu_read_unlock(struct srcu_struct *s, int idx)
+{
+	pthread_rwlock_unlock(&s->rw);
+}
+
+static inline void synchronize_srcu(struct srcu_struct *s)
+{
+	pthread_rwlock_wrlock(&s->rw);
+	pthread_rwlock_unlock(&s->rw);
+}
+
+/******************************************************************************/
+/* Static keys */
+struct static_key_false { int enabled; };
+#define DEFINE_STATIC_KEY_FALSE(n)	struct static_key_false n = { 0 }
+#define static_key_enabled(k)		(__atomic_load_n(&(k)->enabled, __ATOMIC_RELAXED) > 0)
+#define static_branch_unlikely(k)	__builtin_expect(static_key_enabled(k), 0)
+#define static_branch_inc(k)		__atomic_add_fetch(&(k)->enabled, 1, __ATOMIC_SEQ_CST)
+#define static_branch_dec(k)		__atomic_sub_fetch(&(k)->enabled, 1, __ATOMIC_SEQ_CST)
+#define static_branch_enable(k)		__atomic_store_n(&(k)->enabled, 1, __ATOMIC_SEQ_CST)
+#define static_branch_disable(k)	__atomic_store_n(&(k)->enabled, 0, __ATOMIC_SEQ_CST)
+
+/******************************************************************************/
+/* Per cpu data: one instance shared by all threads */
+#define DEFINE_PER_CPU(t, n)		t n
+#define this_cpu_inc(x)			__atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED)
+#define this_cpu_add(x, n)		__atomic_add_fetch(&(x), (n), __ATOMIC_RELAXED)
+#define per_cpu_ptr(p, cpu)		((void)(cpu), (p))
+#define for_each_possible_cpu(cpu)	for ((cpu) = 0; (cpu) < 1; (cpu)++)
+#define nr_cpu_ids			1
+#define smp_processor_id()		0
+
+static inline u64 local_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/******************************************************************************/
+/* Atomics */
+typedef struct { int counter; } atomic_t;
+#define atomic_read(v)			__atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_inc(v)			__atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+
+/******************************************************************************/
+/* Time and sleeping: sleeps are nanosleep, there is no atomic context */
+#define NSEC_PER_USEC			1000UL
+typedef s64 ktime_t;
+#define ktime_get_ns()			local_clock()
+#define ns_to_ktime(ns)			((ktime_t)(ns))
+#if defined(__i386__) || defined(__x86_64__)
+#define cpu_relax()			__builtin_ia32_pause()
+#else
+#define cpu_relax()			__asm__ __volatile__("" ::: "memory")
+#endif
+#define might_sleep()			do { } while (0)
+#define WARN_ON_ONCE(c)			(!!(c))
+#define TASK_UNINTERRUPTIBLE		2
+#define set_current_state(s)		do { } while (0)
+#define HRTIMER_MODE_REL		1
+
+static inline void ga_shim_sleep_ns(u64 ns)
+{
+	struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+
+	nanosleep(&ts, NULL);
+}
+
+static inline void udelay(unsigned long us)
+{
+	u64 end = local_clock() + (u64)us * 1000;
+
+	while (local_clock() < end)
+		;
+}
+
+#define usleep_range(min, max)		ga_shim_sleep_ns((u64)(min) * 1000)
+
+static inline int schedule_hrtimeout_range(ktime_t *expires, u64 delta, int mode)
+{
+	ga_shim_sleep_ns(*expires);
+	return 0;
+}
+
+/******************************************************************************/
+/* Work queues: there is no worker, so posted writes are only written by reads,
+ * ga_flush, a full queue and the removal of the hooks
+ */
+#define usecs_to_jiffies(us)		((unsigned long)(us))
+struct work_struct { void (*func)(struct work_struct *); };
+struct delayed_work { struct work_struct work; };
+#define INIT_DELAYED_WORK(w, f)		((w)->work.func = (f))
+#define to_delayed_work(w)		container_of(w, struct delayed_work, work)
+static inline bool schedule_delayed_work(struct delayed_work *w, unsigned long delay) { return true; }
+static inline bool cancel_delayed_work_sync(struct delayed_work *w) { return false; }
+
+/******************************************************************************/
+/* hrtimers: a thread which calls the function every period until cancelled;
+ * wait queues are polled
+ */
+enum hrtimer_restart { HRTIMER_NORESTART, HRTIMER_RESTART };
+struct hrtimer {
+	enum hrtimer_restart	(*function)(struct hrtimer *);
+	pthread_t		thread;
+	ktime_t			period;
+	volatile int		running;
+};
+
+#define hrtimer_init(t, clock, mode)	memset(t, 0, sizeof(*(t)))
+#define hrtimer_forward_now(t, p)	((t)->period = (p))
+
+static inline void *ga_shim_hrtimer_fn(void *data)
+{
+	struct hrtimer *t = data;
+
+	while (t->running) {
+		ga_shim_sleep_ns(t->period);
+		if (t->running && (t->function(t) == HRTIMER_NORESTART))
+			break;
+	}
+	return NULL;
+}
+
+static inline void hrtimer_start(struct hrtimer *t, ktime_t period, int mode)
+{
+	t->period = period;
+	t->running = 1;
+	pthread_create(&t->thread, NULL, ga_shim_hrtimer_fn, t);
+}
+
+static inline int hrtimer_cancel(struct hrtimer *t)
+{
+	if (!t->running)
+		return 0;
+	t->running = 0;
+	pthread_join(t->thread, NULL);
+	return 1;
+}
+
+typedef struct { int dummy; } wait_queue_head_t;
+#define init_waitqueue_head(w)		((void)(w))
+#define wake_up_interruptible(w)	((void)(w))
+#define wait_event_interruptible(w, cond)						\
+	({ while (!(cond)) ga_shim_sleep_ns(100000); 0; })
+
+#define smp_store_release(p, v)		__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define smp_load_acquire(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_wmb()			__atomic_thread_fence(__ATOMIC_RELEASE)
+#define synchronize_rcu()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/******************************************************************************/
+/* Lists */
+struct list_head { struct list_head *next, *prev; };
+#define LIST_HEAD_INIT(n)		{ &(n), &(n) }
+#define LIST_HEAD(n)			struct list_head n = LIST_HEAD_INIT(n)
+#define INIT_LIST_HEAD(h)		do { (h)->next = (h); (h)->prev = (h); } while (0)
+#define list_entry(p, t, m)		container_of(p, t, m)
+
+static inline void __list_add(struct list_head *n, struct list_head *prev, struct list_head *next)
+{
+	next->prev = n;
+	n->next = next;
+	n->prev = prev;
+	prev->next = n;
+}
+
+static inline void list_add(struct list_head *n, struct list_head *h) { __list_add(n, h, h->next); }
+static inline void list_add_tail(struct list_head *n, struct list_head *h) { __list_add(n, h->prev, h); }
+static inline int list_empty(const struct list_head *h) { return h->next == h; }
+
+static inline void list_del(struct list_head *e)
+{
+	e->next->prev = e->prev;
+	e->prev->next = e->next;
+}
+
+#define list_for_each_entry(pos, head, m)						\
+	for (pos = list_entry((head)->next, __typeof__(*pos), m);			\
+	     &pos->m != (head);								\
+	     pos = list_entry(pos->m.next, __typeof__(*pos), m))
+
+#define list_for_each_entry_safe(pos, n, head, m)					\
+	for (pos = list_entry((head)->next, __typeof__(*pos), m),			\
+	     n = list_entry(pos->m.next, __typeof__(*pos), m);				\
+	     &pos->m != (head);								\
+	     pos = n, n = list_entry(n->m.next, __typeof__(*n), m))
+
+/******************************************************************************/
+/* Latched rbtree: a sorted list protected by a rwlock */
+struct latch_tree_node { struct latch_tree_node *next; };
+struct latch_tree_root { struct latch_tree_node *head; pthread_rwlock_t rw; };
+struct latch_tree_ops {
+	bool (*less)(struct latch_tree_node *a, struct latch_tree_node *b);
+	int (*comp)(void *key, struct latch_tree_node *b);
+};
+
+static inline void latch_tree_insert(struct latch_tree_node *node, struct latch_tree_root *root,
+	const struct latch_tree_ops *ops)
+{
+	struct latch_tree_node **pp;
+
+	pthread_rwlock_wrlock(&root->rw);
+	for (pp = &root->head; *pp && ops->less(*pp, node); pp = &(*pp)->next)
+		;
+	node->next = *pp;
+	*pp = node;
+	pthread_rwlock_unlock(&root->rw);
+}
+
+static inline void latch_tree_erase(struct latch_tree_node *node, struct latch_tree_root *root,
+	const struct latch_tree_ops *ops)
+{
+	struct latch_tree_node **pp;
+
+	pthread_rwlock_wrlock(&root->rw);
+	for (pp = &root->head; *pp; pp = &(*pp)->next) {
+		if (*pp == node) {
+			*pp = node->next;
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&root->rw);
+}
+
+static inline struct latch_tree_node *latch_tree_find(void *key, struct latch_tree_root *root,
+	const struct latch_tree_ops *ops)
+{
+	struct latch_tree_node *n;
+
+	pthread_rwlock_rdlock(&root->rw);
+	for (n = root->head; n; n = n->next)
+		if (ops->comp(key, n) == 0)
+			break;
+	pthread_rwlock_unlock(&root->rw);
+	return n;
+}
+
+/******************************************************************************/
+/* debugfs and seq_file: files are printed to stdout by ga_shim_debugfs_show() */
+struct dentry;
+struct inode;
+struct file;
+struct vm_area_struct { unsigned long vm_pgoff; };
+
+struct seq_file { FILE *f; };
+#define seq_printf(m, ...)		fprintf((m)->f, __VA_ARGS__)
+
+struct file_operations {
+	void	*owner;
+	int	(*open)(struct inode *, struct file *);
+	ssize_t	(*read)(struct file *, char __user *, size_t, loff_t *);
+	ssize_t	(*write)(struct file *, const char __user *, size_t, loff_t *);
+	loff_t	(*llseek)(struct file *, loff_t, int);
+	int	(*release)(struct inode *, struct file *);
+	int	(*mmap)(struct file *, struct vm_area_struct *);
+};
+
+static inline int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data)
+{
+	struct seq_file m = { stdout };
+	return show(&m, data);
+}
+
+static inline ssize_t seq_read(struct file *f, char __user *b, size_t s, loff_t *p) { return 0; }
+static inline loff_t seq_lseek(struct file *f, loff_t o, int w) { return 0; }
+static inline int single_release(struct inode *i, struct file *f) { return 0; }
+static inline loff_t default_llseek(struct file *f, loff_t o, int w) { return 0; }
+static inline int remap_vmalloc_range(struct vm_area_struct *vma, void *addr, unsigned long pgoff) { return -ENOSYS; }
+
+static inline ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos, const void *from, size_t available)
+{
+	if ((*ppos < 0) || ((size_t)*ppos >= available))
+		return 0;
+	count = min(count, available - (size_t)*ppos);
+	memcpy(to, (const char *)from + *ppos, count);
+	*ppos += count;
+	return count;
+}
+
+struct ga_shim_attribute { int (*get)(void *, u64 *); int (*set)(void *, u64); };
+#define DEFINE_DEBUGFS_ATTRIBUTE(n, g, s, f) static const struct ga_shim_attribute n = { g, s }
+
+#define GA_SHIM_DEBUGFS_FILES		8
+struct ga_shim_debugfs { const char *name; const struct file_operations *fops; };
+__attribute__((weak)) struct ga_shim_debugfs ga_shim_debugfs[GA_SHIM_DEBUGFS_FILES];
+
+static inline struct dentry *debugfs_create_dir(const char *name, struct dentry *parent) { return NULL; }
+static inline void debugfs_remove_recursive(struct dentry *d) { }
+
+static inline struct dentry *debugfs_create_file(const char *name, int mode, struct dentry *parent,
+	void *data, const struct file_operations *fops)
+{
+	int i;
+
+	for (i = 0; i < GA_SHIM_DEBUGFS_FILES; i++) {
+		if (ga_shim_debugfs[i].name == NULL) {
+			ga_shim_debugfs[i].name = name;
+			ga_shim_debugfs[i].fops = fops;
+			break;
+		}
+	}
+	return NULL;
+}
+
+static inline struct dentry *debugfs_create_file_unsafe(const char *name, int mode, struct dentry *parent,
+	void *data, const void *fops)
+{
+	return NULL;
+}
+
+#define debugfs_file_get(d)		0
+#define debugfs_file_put(d)		do { } while (0)
+
+static inline int ga_shim_debugfs_show(const char *name)
+{
+	int i;
+
+	for (i = 0; i < GA_SHIM_DEBUGFS_FILES; i++)
+		if ((ga_shim_debugfs[i].name != NULL) && (strcmp(ga_shim_debugfs[i].name, name) == 0))
+			return ga_shim_debugfs[i].fops->open ? ga_shim_debugfs[i].fops->open(NULL, NULL) : -EINVAL;
+	return -ENOENT;
+}
+
+/******************************************************************************/
+/* Entry points of the library (module_init/module_exit) */
+int ga_module_init(void);
+void ga_module_exit(void);
+
+#endif
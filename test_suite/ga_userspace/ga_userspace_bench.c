@@ -0,0 +1,160 @@
+/*
+ * ga_userspace_bench - contention benchmark of generic_access in userspace
+ *
+ * generic/generic_access.c is built against ga_shim.h, with malloc'ed memory
+ * as registers, so locking changes can be measured on a development machine.
+ * Like generic/ga_bench.c, every thread does a read/update/write and a read
+ * of its register per iteration, for 1, 2, 4, ... threads, in GA_LM_SPINLOCK
+ * and GA_LM_MUTEX mode.
+ *
+ * Usage: ga_userspace_bench [-t threads] [-i iterations] [-a access size]
+ *                           [-m lock mode] [-s] [-v]
+ *   -s  all threads access the same register (default: one page per thread)
+ *   -m  0 = spinlock, 1 = mutex (default: both)
+ *   -v  print the access statistics (debugfs stats) at the end
+ * Module parameters of generic_access are read from the environment,
+ * e.g. GA_stats=1 to collect the statistics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "ga_shim.h"
+#include "generic_access.h"
+
+struct bench_thread {
+	pthread_t	thread;
+	void __iomem	*reg;
+	double		elapsed;
+};
+
+static int iterations = 1000000;
+static int access_size = 32;
+static pthread_barrier_t start_barrier;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	double start;
+	u64 val;
+	int i;
+
+	pthread_barrier_wait(&start_barrier);
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		ga_reg_write(t->reg, access_size, 0x0f, i, GA_READ_WRITE_ALWAYS);
+		ga_reg_read(t->reg, access_size, ~0ULL, &val);
+	}
+	t->elapsed = now() - start;
+	return NULL;
+}
+
+static int bench_run(struct bench_thread *t, int count, int mode)
+{
+	double elapsed = 0;
+	int i;
+
+	pthread_barrier_init(&start_barrier, NULL, count);
+	for (i = 0; i < count; i++) {
+		if (pthread_create(&t[i].thread, NULL, bench_thread_fn, &t[i])) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0; i < count; i++) {
+		pthread_join(t[i].thread, NULL);
+		if (t[i].elapsed > elapsed)
+			elapsed = t[i].elapsed;
+	}
+	pthread_barrier_destroy(&start_barrier);
+
+	/* Every iteration does one read/modify/write and one read */
+	printf("%-8s %3d threads: %12.0f accesses/s (%.0f ms)\n", mode == GA_LM_MUTEX ? "mutex" : "spinlock",
+		count, (double)count * iterations * 2 / elapsed, elapsed * 1000);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_thread *t;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int shared = 0, verbose = 0, mode = -1;
+	u8 *regs;
+	int c, i, count;
+
+	while ((c = getopt(argc, argv, "t:i:a:m:sv")) != -1) {
+		switch (c) {
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'a':
+			access_size = atoi(optarg);
+			break;
+		case 'm':
+			mode = atoi(optarg);
+			break;
+		case 's':
+			shared = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t threads] [-i iterations] [-a access size] [-m lock mode] [-s] [-v]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ((threads <= 0) || (iterations <= 0) ||
+	    ((access_size != 8) && (access_size != 16) && (access_size != 32) && (access_size != 64))) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	if (ga_module_init() < 0)
+		return 1;
+
+	t = calloc(threads, sizeof(*t));
+	regs = aligned_alloc(PAGE_SIZE, threads * PAGE_SIZE);
+	if ((t == NULL) || (regs == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	memset(regs, 0, threads * PAGE_SIZE);
+	for (i = 0; i < threads; i++)
+		t[i].reg = regs + (shared ? 0 : i * PAGE_SIZE);
+
+	printf("%s register(s), %d-bit, %d iterations\n", shared ? "shared" : "per-thread", access_size, iterations);
+	for (i = GA_LM_SPINLOCK; i <= GA_LM_MUTEX; i++) {
+		if ((mode >= 0) && (mode != i))
+			continue;
+		ga_set_lock_mode(i);
+		for (count = 1; ; count = (count * 2 < threads) ? count * 2 : threads) {
+			bench_run(t, count, i);
+			if (count == threads)
+				break;
+		}
+	}
+
+	if (verbose)
+		ga_shim_debugfs_show("stats");
+
+	ga_module_exit();
+	free(regs);
+	free(t);
+	return 0;
+}
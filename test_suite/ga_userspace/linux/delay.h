@@ -0,0 +1,2 @@
+/* Userspace build of generic_access, see ../ga_shim.h */
+#include "../ga_shim.h"
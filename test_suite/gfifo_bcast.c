@@ -0,0 +1,189 @@
+/*
+ * gfifo_bcast - one writer fanned out to several readers (broadcast mode)
+ *
+ * Usage: gfifo_bcast [-r readers] [-p block|overrun] [-s slow reader us] [-m megabytes] [device]
+ *
+ * The fifo (default /dev/gfifo0) is switched to broadcast mode with the given
+ * policy (default block). <readers> processes (default 3) open it and read
+ * everything the writer sends (default 16 MB); the last one sleeps <slow
+ * reader us> after every read (default 0). With the block policy every reader
+ * must get every byte, in order. With the overrun policy the slow reader
+ * should see EPIPE and the writer should not slow down. A reader stops after
+ * one second without data. The lag of each reader can be watched in
+ * /sys/kernel/debug/<module>/ meanwhile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include "gfifo_bcast.h"
+
+#define FIFO_BROADCAST 0x6
+#define MAX_READERS 64
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int reader(const char *path, int id, int policy, long slow, int ready)
+{
+	unsigned char buf[4096];
+	unsigned long pos = 0, epipes = 0;
+	struct pollfd pfd;
+	double start = 0, end = 0;
+	ssize_t n, i;
+
+	pfd.fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (pfd.fd < 0) {
+		perror(path);
+		return 1;
+	}
+	pfd.events = POLLIN;
+	if (write(ready, "", 1) != 1)
+		return 1;
+
+	while (poll(&pfd, 1, 1000) > 0) {
+		n = read(pfd.fd, buf, sizeof(buf));
+		if ((n < 0) && (errno == EPIPE)) {
+			epipes++;
+			continue;
+		}
+		if (n < 0) {
+			if (errno == EAGAIN)
+				continue;
+			perror("read");
+			return 1;
+		}
+		if (start == 0)
+			start = now();
+		end = now();
+		if (policy == GFIFO_BCAST_BLOCK) {
+			for (i = 0; i < n; i++) {
+				if (buf[i] != (unsigned char)(pos + i)) {
+					fprintf(stderr, "reader %d: bad data at byte %lu\n", id, pos + i);
+					return 1;
+				}
+			}
+		}
+		pos += n;
+		if (slow)
+			usleep(slow);
+	}
+
+	printf("reader %d: %lu bytes, %lu EPIPE, %.1f MB/s\n", id, pos, epipes,
+		end > start ? pos / (end - start) / 1e6 : 0);
+	close(pfd.fd);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long readers = 3, slow = 0, megabytes = 16, i;
+	int policy = GFIFO_BCAST_BLOCK, status, ret = 0;
+	unsigned char buf[4096];
+	unsigned long pos = 0, total;
+	int fd, ready[2], c;
+	double start;
+	char dummy;
+
+	while ((c = getopt(argc, argv, "r:p:s:m:")) != -1) {
+		switch (c) {
+		case 'r':
+			readers = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			policy = strcmp(optarg, "overrun") ? GFIFO_BCAST_BLOCK : GFIFO_BCAST_OVERRUN;
+			break;
+		case 's':
+			slow = strtol(optarg, NULL, 0);
+			break;
+		case 'm':
+			megabytes = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-r readers] [-p block|overrun] [-s slow reader us] [-m megabytes] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((readers <= 0) || (readers > MAX_READERS) || (slow < 0) || (megabytes <= 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+	total = megabytes << 20;
+
+	/* Drain, then switch; the writer must not be a reader itself */
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	close(fd);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if (ioctl(fd, FIFO_BROADCAST, policy) < 0) {
+		perror("FIFO_BROADCAST");
+		return 1;
+	}
+
+	if (pipe(ready) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	for (i = 0; i < readers; i++) {
+		if (fork() == 0) {
+			close(fd);
+			close(ready[0]);
+			exit(reader(path, i, policy, i == readers - 1 ? slow : 0, ready[1]));
+		}
+	}
+	close(ready[1]);
+	for (i = 0; i < readers; i++) {
+		if (read(ready[0], &dummy, 1) != 1) {
+			fprintf(stderr, "A reader failed to start\n");
+			return 1;
+		}
+	}
+
+	start = now();
+	while (pos < total) {
+		ssize_t n;
+
+		for (i = 0; i < (long)sizeof(buf); i++)
+			buf[i] = (unsigned char)(pos + i);
+		n = write(fd, buf, sizeof(buf));
+		if (n < 0) {
+			perror("write");
+			ret = 1;
+			break;
+		}
+		pos += n;
+	}
+	printf("writer: %lu bytes, %.1f MB/s\n", pos, pos / (now() - start) / 1e6);
+
+	while (wait(&status) > 0)
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			ret = 1;
+	if (ioctl(fd, FIFO_BROADCAST, GFIFO_BCAST_OFF) < 0)
+		perror("FIFO_BROADCAST");
+	close(fd);
+	return ret;
+}
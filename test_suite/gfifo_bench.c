@@ -0,0 +1,121 @@
+/*
+ * gfifo_bench - cost of small reads on a gfifo device at different fill levels
+ *
+ * Usage: gfifo_bench [-s fifo size] [-b bytes per read] [-i iterations] [device]
+ *
+ * The fifo (default /dev/gfifo0, opened non-blocking) is drained and resized
+ * to <fifo size> (FIFO_RESIZE, default 256 bytes), then filled to 0%, 25%,
+ * 50%, 75% and 100% minus one read. At each level, every iteration writes and
+ * reads <bytes> so the level stays the same, and the average cost of the read
+ * is printed. With the ring buffer the cost is flat; the old memmove-on-read
+ * grew with the fill level.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#define FIFO_RESIZE 0x2
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int fill(int fd, char *buf, long bytes)
+{
+	while (bytes > 0) {
+		ssize_t n = write(fd, buf, bytes);
+		if (n <= 0) {
+			perror("write");
+			return -1;
+		}
+		bytes -= n;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long size = 0x100, bytes = 16, iterations = 100000;
+	double start, read_time;
+	char *buf;
+	int fd, c, level;
+	long i;
+
+	while ((c = getopt(argc, argv, "s:b:i:")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			bytes = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s fifo size] [-b bytes per read] [-i iterations] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((bytes <= 0) || (bytes > size) || (iterations <= 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	fd = open(path, O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	buf = calloc(1, size);
+	if (buf == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	while (read(fd, buf, size) > 0)
+		;
+	if (ioctl(fd, FIFO_RESIZE, size) < 0) {
+		perror("FIFO_RESIZE");
+		return 1;
+	}
+
+	printf("%s: %ld bytes, reads of %ld bytes\n", path, size, bytes);
+	for (level = 0; level <= 100; level += 25) {
+		long fill_bytes = size * level / 100 - (level == 100 ? bytes : 0);
+
+		/* Drain, then fill to the level */
+		while (read(fd, buf, size) > 0)
+			;
+		if (fill(fd, buf, fill_bytes) < 0)
+			return 1;
+
+		read_time = 0;
+		for (i = 0; i < iterations; i++) {
+			if (fill(fd, buf, bytes) < 0)
+				return 1;
+			start = now();
+			if (read(fd, buf, bytes) != bytes) {
+				perror("read");
+				return 1;
+			}
+			read_time += now() - start;
+		}
+		printf("fill %3d%%: %8.0f ns per read\n", level, read_time * 1e9 / iterations);
+	}
+
+	free(buf);
+	close(fd);
+	return 0;
+}
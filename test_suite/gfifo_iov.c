@@ -0,0 +1,140 @@
+/*
+ * gfifo_iov - vectored and non-blocking I/O on a gfifo device
+ *
+ * Usage: gfifo_iov [-n segments] [-b bytes per segment] [-i iterations] [device]
+ *
+ * The fifo (default /dev/gfifo0) is opened blocking. A preadv2(RWF_NOWAIT) of
+ * the empty fifo must fail with EAGAIN at once (IOCB_NOWAIT, as io_uring
+ * issues it). Then each iteration writes <segments> x <bytes> with one writev,
+ * reads them back with one readv and checks them; the time of the readv is
+ * compared with one read() per segment. The fifo must hold segments x bytes
+ * (default 16 x 16).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#define MAX_SEGMENTS 1024
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long segments = 16, bytes = 16, iterations = 10000, i, j;
+	struct iovec iov[MAX_SEGMENTS];
+	double start, readv_time = 0, read_time = 0;
+	unsigned char *buf;
+	unsigned long pos = 0;
+	char drain[4096];
+	ssize_t n;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "n:b:i:")) != -1) {
+		switch (c) {
+		case 'n':
+			segments = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			bytes = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n segments] [-b bytes per segment] [-i iterations] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((segments <= 0) || (segments > MAX_SEGMENTS) || (bytes <= 0) || (iterations <= 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	buf = malloc(segments * bytes);
+	if (buf == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < segments; i++) {
+		iov[i].iov_base = buf + i * bytes;
+		iov[i].iov_len = bytes;
+	}
+
+	/* Drain without blocking, then the empty fifo must not block either */
+	iov[0].iov_base = drain;
+	iov[0].iov_len = sizeof(drain);
+	while ((n = preadv2(fd, iov, 1, -1, RWF_NOWAIT)) > 0)
+		;
+	if ((n == 0) || (errno != EAGAIN)) {
+		fprintf(stderr, "preadv2(RWF_NOWAIT) of the empty fifo: %s\n", n ? strerror(errno) : "end of file");
+		return 1;
+	}
+	iov[0].iov_base = buf;
+	iov[0].iov_len = bytes;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < segments * bytes; j++)
+			buf[j] = (unsigned char)(pos + j);
+		n = writev(fd, iov, segments);
+		if (n != segments * bytes) {
+			fprintf(stderr, "writev: %zd of %ld bytes (fifo too small?)\n", n, segments * bytes);
+			return 1;
+		}
+		memset(buf, 0, segments * bytes);
+		start = now();
+		n = readv(fd, iov, segments);
+		readv_time += now() - start;
+		if (n != segments * bytes) {
+			fprintf(stderr, "readv: %zd of %ld bytes\n", n, segments * bytes);
+			return 1;
+		}
+		for (j = 0; j < segments * bytes; j++) {
+			if (buf[j] != (unsigned char)(pos + j)) {
+				fprintf(stderr, "bad data at byte %lu\n", pos + j);
+				return 1;
+			}
+		}
+		pos += segments * bytes;
+
+		if (writev(fd, iov, segments) != segments * bytes) {
+			perror("writev");
+			return 1;
+		}
+		start = now();
+		for (j = 0; j < segments; j++) {
+			if (read(fd, iov[j].iov_base, bytes) != bytes) {
+				perror("read");
+				return 1;
+			}
+		}
+		read_time += now() - start;
+	}
+
+	printf("%s: %ld segments of %ld bytes\n", path, segments, bytes);
+	printf("readv:        %8.0f ns\n", readv_time * 1e9 / iterations);
+	printf("read x %-5ld %8.0f ns\n", segments, read_time * 1e9 / iterations);
+	free(buf);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * gfifo_mmap_bench - throughput of a gfifo device with read()/write() and with
+ * the shared memory ring (see generic/gfifo_mmap.h)
+ *
+ * Usage: gfifo_mmap_bench [-s fifo size] [-b bytes per transfer] [-n total MB] [device]
+ *
+ * The fifo (default /dev/gfifo0) is drained and resized to <fifo size>
+ * (FIFO_RESIZE, default 64 KiB). A producer process then sends <total> MB to a
+ * consumer process in chunks of <bytes> (default 4096), first with write() and
+ * read(), then through the mapped ring, where the kernel is only entered to
+ * wait (poll) and to notify the empty->non-empty and full->non-full transitions
+ * (FIFO_NOTIFY). The consumer checks the data and the throughput is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "gfifo_mmap.h"
+
+#define FIFO_RESIZE 0x2
+#define FIFO_NOTIFY 0x3
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pattern(unsigned char *buf, long pos, long bytes)
+{
+	long i;
+
+	for (i = 0; i < bytes; i++)
+		buf[i] = (unsigned char)((pos + i) * 7);
+}
+
+static int check(const unsigned char *buf, long pos, long bytes)
+{
+	long i;
+
+	for (i = 0; i < bytes; i++) {
+		if (buf[i] != (unsigned char)((pos + i) * 7)) {
+			fprintf(stderr, "bad data at byte %ld\n", pos + i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void wait_for(int fd, short events)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+
+	poll(&pfd, 1, -1);
+}
+
+/* read()/write() mode */
+static int produce_rw(int fd, unsigned char *buf, long bytes, long total)
+{
+	long pos = 0;
+
+	while (pos < total) {
+		long n = total - pos < bytes ? total - pos : bytes;
+		ssize_t done;
+
+		pattern(buf, pos, n);
+		done = write(fd, buf, n);
+		if (done < 0) {
+			perror("write");
+			return -1;
+		}
+		pos += done;
+	}
+	return 0;
+}
+
+static int consume_rw(int fd, unsigned char *buf, long bytes, long total)
+{
+	long pos = 0;
+
+	while (pos < total) {
+		ssize_t done = read(fd, buf, bytes);
+
+		if (done < 0) {
+			perror("read");
+			return -1;
+		}
+		if (check(buf, pos, done) < 0)
+			return -1;
+		pos += done;
+	}
+	return 0;
+}
+
+/* Mapped ring mode */
+static int produce_mmap(int fd, struct gfifo_ring_ctrl *ctrl, unsigned char *data, unsigned char *buf,
+	long bytes, long total)
+{
+	unsigned int size = ctrl->size, in = __atomic_load_n(&ctrl->in, __ATOMIC_RELAXED);
+	long pos = 0;
+
+	while (pos < total) {
+		unsigned int out = __atomic_load_n(&ctrl->out, __ATOMIC_ACQUIRE);
+		unsigned int n = size - (in - out), off = in & (size - 1), first;
+
+		if (n == 0) {
+			wait_for(fd, POLLOUT);
+			continue;
+		}
+		if (n > bytes)
+			n = bytes;
+		if (n > total - pos)
+			n = total - pos;
+		first = n < size - off ? n : size - off;
+
+		pattern(buf, pos, n);
+		memcpy(data + off, buf, first);
+		memcpy(data, buf + first, n - first);
+		__atomic_store_n(&ctrl->in, in + n, __ATOMIC_RELEASE);
+		/* Order the store of 'in' before the load of 'out' (see gfifo_mmap.h) */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ctrl->out, __ATOMIC_RELAXED) == in)
+			ioctl(fd, FIFO_NOTIFY);
+		in += n;
+		pos += n;
+	}
+	return 0;
+}
+
+static int consume_mmap(int fd, struct gfifo_ring_ctrl *ctrl, unsigned char *data, unsigned char *buf,
+	long bytes, long total)
+{
+	unsigned int size = ctrl->size, out = __atomic_load_n(&ctrl->out, __ATOMIC_RELAXED);
+	long pos = 0;
+
+	while (pos < total) {
+		unsigned int in = __atomic_load_n(&ctrl->in, __ATOMIC_ACQUIRE);
+		unsigned int n = in - out, off = out & (size - 1), first;
+
+		if (n == 0) {
+			wait_for(fd, POLLIN);
+			continue;
+		}
+		if (n > bytes)
+			n = bytes;
+		first = n < size - off ? n : size - off;
+
+		memcpy(buf, data + off, first);
+		memcpy(buf + first, data, n - first);
+		if (check(buf, pos, n) < 0)
+			return -1;
+		__atomic_store_n(&ctrl->out, out + n, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ctrl->in, __ATOMIC_RELAXED) - out == size)
+			ioctl(fd, FIFO_NOTIFY);
+		out += n;
+		pos += n;
+	}
+	return 0;
+}
+
+static int run(const char *path, int mapped, long size, long bytes, long total)
+{
+	struct gfifo_ring_ctrl *ctrl = NULL;
+	unsigned char *buf, *data = NULL;
+	double start;
+	pid_t pid;
+	int fd, status, ret;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	buf = malloc(bytes);
+	if (buf == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+	if (mapped) {
+		ctrl = mmap(NULL, GFIFO_MMAP_DATA_OFFSET + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ctrl == MAP_FAILED) {
+			perror("mmap");
+			return -1;
+		}
+		data = (unsigned char *)ctrl + GFIFO_MMAP_DATA_OFFSET;
+	}
+
+	start = now();
+	pid = fork();
+	if (pid == 0) {
+		ret = mapped ? produce_mmap(fd, ctrl, data, buf, bytes, total) : produce_rw(fd, buf, bytes, total);
+		_exit(ret ? 1 : 0);
+	}
+	ret = mapped ? consume_mmap(fd, ctrl, data, buf, bytes, total) : consume_rw(fd, buf, bytes, total);
+	waitpid(pid, &status, 0);
+	if (ret == 0 && (!WIFEXITED(status) || WEXITSTATUS(status)))
+		ret = -1;
+	if (ret == 0)
+		printf("%-12s %8.1f MB/s\n", mapped ? "mmap:" : "read/write:", total / (now() - start) / 1e6);
+
+	if (mapped)
+		munmap(ctrl, GFIFO_MMAP_DATA_OFFSET + size);
+	free(buf);
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long size = 0x10000, bytes = 4096, total = 256;
+	char *buf;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "s:b:n:")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			bytes = strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			total = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s fifo size] [-b bytes per transfer] [-n total MB] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((size <= 0) || (size & (size - 1)) || (bytes <= 0) || (total <= 0)) {
+		fprintf(stderr, "Invalid arguments (the fifo size is a power of 2)\n");
+		return 1;
+	}
+	total <<= 20;
+
+	fd = open(path, O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	buf = malloc(size);
+	if (buf == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	while (read(fd, buf, size) > 0)
+		;
+	if (ioctl(fd, FIFO_RESIZE, size) < 0) {
+		perror("FIFO_RESIZE");
+		return 1;
+	}
+	free(buf);
+	close(fd);
+
+	printf("%s: %ld bytes, transfers of %ld bytes, %ld MB\n", path, size, bytes, total >> 20);
+	if (run(path, 0, size, bytes, total) < 0 || run(path, 1, size, bytes, total) < 0)
+		return 1;
+	return 0;
+}
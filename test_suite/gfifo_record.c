@@ -0,0 +1,192 @@
+/*
+ * gfifo_record - record mode of a gfifo device (see generic/gfifo_record.h)
+ *
+ * Usage: gfifo_record [-m message bytes] [-i iterations] [device]
+ *
+ * The fifo (default /dev/gfifo0, opened non-blocking) is drained and switched
+ * to record mode (FIFO_RECORD). Each iteration fills it with messages of 1 to
+ * <message bytes> bytes (default 32), then drains them, alternately with one
+ * read() per message and with FIFO_READ_BATCH, and checks that every message
+ * comes back whole. A read() into a too small buffer must fail with EMSGSIZE.
+ * The average cost per message of both ways is printed, then the fifo is
+ * switched back to a byte stream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "gfifo_record.h"
+
+#define FIFO_RECORD 0x4
+#define FIFO_READ_BATCH 0x5
+#define MAX_RECORDS 4096
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int msg_len(unsigned long seq, long max)
+{
+	return 1 + (seq * 2654435761UL >> 8) % max;
+}
+
+static void msg_fill(unsigned char *buf, unsigned long seq, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)(seq * 31 + i);
+}
+
+static int msg_check(const unsigned char *buf, unsigned long seq, unsigned int len, long max)
+{
+	unsigned int i;
+
+	if (len != msg_len(seq, max)) {
+		fprintf(stderr, "message %lu: %u bytes instead of %u\n", seq, len, msg_len(seq, max));
+		return -1;
+	}
+	for (i = 0; i < len; i++) {
+		if (buf[i] != (unsigned char)(seq * 31 + i)) {
+			fprintf(stderr, "message %lu: bad data at byte %u\n", seq, i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Write messages until the fifo is full, returns the number written */
+static long fill(int fd, unsigned char *buf, unsigned long *seq, long max)
+{
+	long n = 0;
+
+	for (;;) {
+		unsigned int len = msg_len(*seq, max);
+
+		msg_fill(buf, *seq, len);
+		if (write(fd, buf, len) < 0)
+			return errno == EAGAIN ? n : -1;
+		(*seq)++;
+		n++;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long max = 32, iterations = 1000, i, k, n;
+	unsigned long wseq = 0, rseq = 0;
+	static struct gfifo_record_index index[MAX_RECORDS];
+	struct gfifo_read_batch batch;
+	double start, read_time = 0, batch_time = 0;
+	long read_msgs = 0, batch_msgs = 0;
+	unsigned char *buf, *big;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "m:i:")) != -1) {
+		switch (c) {
+		case 'm':
+			max = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-m message bytes] [-i iterations] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((max <= 1) || (iterations <= 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	fd = open(path, O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	buf = malloc(max);
+	big = malloc(max * MAX_RECORDS);
+	if ((buf == NULL) || (big == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	while (read(fd, big, max * MAX_RECORDS) > 0)
+		;
+	if (ioctl(fd, FIFO_RECORD, 1) < 0) {
+		perror("FIFO_RECORD");
+		return 1;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		n = fill(fd, buf, &wseq, max);
+		if (n <= 0) {
+			fprintf(stderr, "write: %s\n", n ? strerror(errno) : "fifo too small");
+			return 1;
+		}
+
+		if (i == 0) {
+			char small;
+
+			if ((msg_len(rseq, max) > 1) && ((read(fd, &small, 1) >= 0) || (errno != EMSGSIZE))) {
+				fprintf(stderr, "read of a too small buffer did not fail with EMSGSIZE\n");
+				return 1;
+			}
+		}
+
+		start = now();
+		if (i & 1) {
+			while (rseq < wseq) {
+				batch.buf = (uintptr_t)big;
+				batch.index = (uintptr_t)index;
+				batch.buf_len = max * MAX_RECORDS;
+				batch.max_records = MAX_RECORDS;
+				if (ioctl(fd, FIFO_READ_BATCH, &batch) < 0) {
+					perror("FIFO_READ_BATCH");
+					return 1;
+				}
+				for (k = 0; k < batch.records; k++, rseq++)
+					if (msg_check(big + index[k].offset, rseq, index[k].len, max) < 0)
+						return 1;
+			}
+			batch_time += now() - start;
+			batch_msgs += n;
+		} else {
+			while (rseq < wseq) {
+				ssize_t len = read(fd, buf, max);
+
+				if (len < 0) {
+					perror("read");
+					return 1;
+				}
+				if (msg_check(buf, rseq++, len, max) < 0)
+					return 1;
+			}
+			read_time += now() - start;
+			read_msgs += n;
+		}
+	}
+
+	if (ioctl(fd, FIFO_RECORD, 0) < 0)
+		perror("FIFO_RECORD");
+	printf("%s: %lu messages of up to %ld bytes\n", path, wseq, max);
+	printf("read():          %8.0f ns per message\n", read_time * 1e9 / (read_msgs ? read_msgs : 1));
+	printf("FIFO_READ_BATCH: %8.0f ns per message\n", batch_time * 1e9 / (batch_msgs ? batch_msgs : 1));
+	free(big);
+	free(buf);
+	close(fd);
+	return 0;
+}
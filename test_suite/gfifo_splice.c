@@ -0,0 +1,175 @@
+/*
+ * gfifo_splice - move data between a gfifo device and a pipe with splice(2)
+ *
+ * Usage: gfifo_splice [-n bytes] [-b bytes per splice] [device]
+ *
+ * A producer process writes <bytes> (default 1 MB) to a pipe, which is spliced
+ * to the fifo (default /dev/gfifo0, splice_write), then the fifo is spliced to
+ * a second pipe (splice_read) which a consumer process reads and checks. The
+ * data never goes through the buffer of the splicing process.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write the data to the input pipe */
+static int producer(int fd, long total)
+{
+	unsigned char buf[4096];
+	long pos = 0, i;
+
+	while (pos < total) {
+		long n = total - pos < (long)sizeof(buf) ? total - pos : (long)sizeof(buf);
+		ssize_t done;
+
+		for (i = 0; i < n; i++)
+			buf[i] = (unsigned char)((pos + i) * 7);
+		done = write(fd, buf, n);
+		if (done < 0) {
+			perror("write pipe");
+			return -1;
+		}
+		pos += done;
+	}
+	return 0;
+}
+
+/* Read and check the data from the output pipe */
+static int consumer(int fd, long total)
+{
+	unsigned char buf[4096];
+	long pos = 0, i;
+
+	while (pos < total) {
+		ssize_t done = read(fd, buf, sizeof(buf));
+
+		if (done <= 0) {
+			fprintf(stderr, "read pipe: %s\n", done ? "error" : "end of data");
+			return -1;
+		}
+		for (i = 0; i < done; i++) {
+			if (buf[i] != (unsigned char)((pos + i) * 7)) {
+				fprintf(stderr, "bad data at byte %ld\n", pos + i);
+				return -1;
+			}
+		}
+		pos += done;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	long total = 1 << 20, bytes = 65536, in = 0, out = 0;
+	int in_pipe[2], out_pipe[2];
+	pid_t producer_pid, consumer_pid;
+	int fd, c, status, ret = 0;
+	double start;
+
+	while ((c = getopt(argc, argv, "n:b:")) != -1) {
+		switch (c) {
+		case 'n':
+			total = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			bytes = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n bytes] [-b bytes per splice] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((total <= 0) || (bytes <= 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	fd = open(path, O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if (pipe(in_pipe) < 0 || pipe(out_pipe) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	producer_pid = fork();
+	if (producer_pid == 0) {
+		close(in_pipe[0]);
+		_exit(producer(in_pipe[1], total) ? 1 : 0);
+	}
+	consumer_pid = fork();
+	if (consumer_pid == 0) {
+		close(out_pipe[1]);
+		_exit(consumer(out_pipe[0], total) ? 1 : 0);
+	}
+	close(in_pipe[1]);
+	close(out_pipe[0]);
+
+	/* The fifo is non-blocking, splice in whatever fits and splice out what is there */
+	start = now();
+	while (out < total) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		int progress = 0;
+		ssize_t n;
+
+		if (in < total) {
+			n = splice(in_pipe[0], NULL, fd, NULL, bytes, SPLICE_F_MOVE);
+			if (n > 0) {
+				in += n;
+				progress = 1;
+			} else if (n == 0 || errno != EAGAIN) {
+				perror("splice to fifo");
+				ret = 1;
+				break;
+			}
+		}
+		n = splice(fd, NULL, out_pipe[1], NULL, bytes, SPLICE_F_MOVE);
+		if (n > 0) {
+			out += n;
+			progress = 1;
+		} else if (n == 0 || errno != EAGAIN) {
+			perror("splice from fifo");
+			ret = 1;
+			break;
+		}
+
+		/* Nothing moved, another user of the fifo holds it: wait for data */
+		if (!progress)
+			poll(&pfd, 1, 100);
+	}
+	close(out_pipe[1]);
+	close(in_pipe[0]);
+
+	waitpid(producer_pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		ret = 1;
+	waitpid(consumer_pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		ret = 1;
+
+	if (ret == 0)
+		printf("%s: %ld bytes spliced in and out, %.1f MB/s\n", path, total, total / (now() - start) / 1e6);
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,153 @@
+/*
+ * gfifo_watermark - wake up thresholds and SIGIO coalescing of gfifo_async
+ *
+ * Usage: gfifo_watermark [-b rx bytes] [-t rx us] [-g sigio us] [-n writes] [-i interval us] [device]
+ *
+ * A child writes <writes> 8 byte timestamps (default 10000), one every
+ * <interval us> (default 100), to the fifo (default /dev/gfifo0). The parent
+ * sets the thresholds of gfifo_watermark.h (default 0: wake up on every
+ * write), enables SIGIO and reads with poll(). It prints how many times it
+ * was woken up, the bytes per wake up, the SIGIOs received and the longest
+ * time a timestamp stayed in the fifo, which should be about <rx us> when
+ * the bytes threshold is not reached.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include "gfifo_watermark.h"
+
+#define FIFO_WATERMARK 0x7
+
+static volatile sig_atomic_t sigios;
+
+static void sigio_handler(int signum)
+{
+	sigios++;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int writer(const char *path, long writes, long interval)
+{
+	uint64_t t;
+	long i;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	for (i = 0; i < writes; i++) {
+		t = now_ns();
+		if (write(fd, &t, sizeof(t)) != sizeof(t)) {
+			perror("write");
+			return 1;
+		}
+		usleep(interval);
+	}
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "/dev/gfifo0";
+	struct gfifo_watermark wm = { 0 };
+	long writes = 10000, interval = 100, wakeups = 0, got = 0, i;
+	uint64_t buf[512], max_delay = 0, t;
+	struct pollfd pfd;
+	int status, c;
+	ssize_t n;
+
+	while ((c = getopt(argc, argv, "b:t:g:n:i:")) != -1) {
+		switch (c) {
+		case 'b':
+			wm.rx_bytes = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			wm.rx_usecs = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			wm.sigio_usecs = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			writes = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b rx bytes] [-t rx us] [-g sigio us] [-n writes] [-i interval us] [device]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if ((writes <= 0) || (interval < 0)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	pfd.fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (pfd.fd < 0) {
+		perror(path);
+		return 1;
+	}
+	pfd.events = POLLIN;
+	while (read(pfd.fd, buf, sizeof(buf)) > 0)
+		;
+	if (ioctl(pfd.fd, FIFO_WATERMARK, &wm) < 0) {
+		perror("FIFO_WATERMARK");
+		return 1;
+	}
+	signal(SIGIO, sigio_handler);
+	fcntl(pfd.fd, F_SETOWN, getpid());
+	fcntl(pfd.fd, F_SETFL, fcntl(pfd.fd, F_GETFL) | O_ASYNC);
+
+	if (fork() == 0)
+		exit(writer(path, writes, interval));
+
+	while (got < writes) {
+		int ret = poll(&pfd, 1, 2000);
+
+		if ((ret < 0) && (errno == EINTR))
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "poll: %s\n", ret ? strerror(errno) : "no data for 2 s");
+			break;
+		}
+		wakeups++;
+		while ((n = read(pfd.fd, buf, sizeof(buf))) > 0) {
+			t = now_ns();
+			for (i = 0; i < n / (long)sizeof(buf[0]); i++)
+				if (t - buf[i] > max_delay)
+					max_delay = t - buf[i];
+			got += n / sizeof(buf[0]);
+		}
+	}
+	wait(&status);
+
+	printf("%s: rx_bytes %u rx_usecs %u sigio_usecs %u\n", path, wm.rx_bytes, wm.rx_usecs, wm.sigio_usecs);
+	printf("%ld writes, %ld wake ups, %.1f bytes per wake up, %d SIGIO, longest wait %.0f us\n",
+		got, wakeups, wakeups ? got * 8.0 / wakeups : 0, (int)sigios, max_delay / 1e3);
+	close(pfd.fd);
+	return got == writes ? 0 : 1;
+}
@@ -30,6 +30,7 @@
 #include <linux/workqueue.h>
 #include "generic_access.h"
 #include "dev_common.h"
+#include "ga_field.h"
 
 /******************************************************************************/
 #define DEV_WATCHDOG_KICK_INTERVAL	1000 /* ms */
@@ -94,27 +95,32 @@ static const struct dev_watchdog_prop watchdog_props[WD_PROP_COUNT] = {
 };
 
 /******************************************************************************/
+/* The kick register is at reg-kick-offset and written whole with reg-kick-value */
+GA_REG(wd_kick, 0, 8);
+GA_FIELD(wd_kick, value, 0, 8);
+
 static void dev_watchdog_kick(void)
 {
 	if (debug)
 		dev_dbg(priv.dev, "dev_watchdog: kick\n");
 
-	dev_write(priv.reg_base + priv.props[WD_PROP_KICK_OFFSET], priv.props[WD_PROP_KICK_VALUE]);
+	ga_field_write(priv.reg_base + priv.props[WD_PROP_KICK_OFFSET], wd_kick, value, priv.props[WD_PROP_KICK_VALUE]);
 }
 
 /******************************************************************************/
 static void dev_watchdog_enable(int enable)
 {
 	if ((priv.props[WD_PROP_ENABLE_OFFSET] != WD_PROP_NONE) && (priv.props[WD_PROP_ENABLE_VALUE] != WD_PROP_NONE)) {
-		int reg;
-
-		/* Set the watchdog state. If no GICI is attached, this will have no effect. */
-		dev_read_modify_write(priv.reg_base + priv.props[WD_PROP_ENABLE_OFFSET],
-			priv.props[WD_PROP_ENABLE_VALUE], enable ? priv.props[WD_PROP_ENABLE_VALUE] : 0x00);
-
-		/* Read back the actual state to handle the case where no GICI is attached. */
-		reg = dev_read(priv.reg_base + priv.props[WD_PROP_ENABLE_OFFSET]);
-		priv.wd_state = (reg & priv.props[WD_PROP_ENABLE_VALUE]) ? WD_STATE_ENABLED : WD_STATE_DISABLED;
+		void __iomem *addr = priv.reg_base + priv.props[WD_PROP_ENABLE_OFFSET];
+		struct ga_reg_op ops[] = {
+			/* Set the watchdog state. If no GICI is attached, this will have no effect. */
+			DEV_OP_READ_MODIFY_WRITE(addr, priv.props[WD_PROP_ENABLE_VALUE], enable ? priv.props[WD_PROP_ENABLE_VALUE] : 0x00),
+			/* Read back the actual state to handle the case where no GICI is attached. */
+			DEV_OP_READ(addr),
+		};
+
+		dev_batch(ops, ARRAY_SIZE(ops));
+		priv.wd_state = (ops[1].result & priv.props[WD_PROP_ENABLE_VALUE]) ? WD_STATE_ENABLED : WD_STATE_DISABLED;
 	}
 
 	if (debug)
@@ -127,7 +133,7 @@ static void dev_watchdog_read_enable(void)
 	priv.wd_state = WD_STATE_UNKNOWN;
 
 	if ((priv.props[WD_PROP_ENABLE_OFFSET] != WD_PROP_NONE) && (priv.props[WD_PROP_ENABLE_VALUE] != WD_PROP_NONE)) {
-		int reg = dev_read(priv.reg_base + priv.props[WD_PROP_ENABLE_OFFSET]);
+		int reg = dev_read_status(priv.reg_base + priv.props[WD_PROP_ENABLE_OFFSET]);
 		priv.wd_state = (reg & priv.props[WD_PROP_ENABLE_VALUE]) ? WD_STATE_ENABLED : WD_STATE_DISABLED;
 	}
 